@@ -0,0 +1,342 @@
+﻿
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+
+#ifdef max
+#undef max
+#endif
+
+#include "log/LogWrapper.h"
+
+#include "Lock/SpinLock.h"
+#include "Lock/TicketLock.h"
+#include "Lock/MCSLock.h"
+#include "Lock/TTASSpinLock.h"
+#include "Lock/FutexLock.h"
+#include "Lock/seq_alloc.h"
+#include "Lock/LockHolder.h"
+
+#include "DataStructure/mpmc_ring_queue.h"
+#include "DataStructure/spsc_ring_queue.h"
+
+#include "MemPool/lru_object_pool.h"
+#include "MemPool/concurrent_lru_pool.h"
+
+// 性能测试只输出耗时，正确性由test下的单元测试保证；需要使用release编译，并且结果和机器的核数有关
+
+static long long benchmark_cost_us(const std::chrono::steady_clock::time_point& begin, const std::chrono::steady_clock::time_point& end) {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+}
+
+//=======================================================================================================
+struct benchmark_lru_data {
+    uint32_t key;
+};
+
+struct benchmark_lru_action : public util::mempool::lru_default_action<benchmark_lru_data> {
+    void gc(benchmark_lru_data*) {}
+};
+
+// 只测试链表节点的存储，不关联manager
+template<typename TPool>
+static double lru_pool_benchmark_push_pull(int loop, int batch) {
+    std::vector<benchmark_lru_data> objs;
+    std::vector<benchmark_lru_data*> pulled;
+    objs.resize(static_cast<size_t>(batch));
+    pulled.resize(static_cast<size_t>(batch), NULL);
+
+    TPool lru;
+    clock_t begin = clock();
+    for (int i = 0; i < loop; ++i) {
+        for (int j = 0; j < batch; ++j) {
+            lru.push(static_cast<uint32_t>(j & 0x07), &objs[j]);
+        }
+
+        for (int j = 0; j < batch; ++j) {
+            pulled[j] = lru.pull(static_cast<uint32_t>(j & 0x07));
+        }
+    }
+    clock_t end = clock();
+
+    return static_cast<double>(end - begin) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+struct benchmark_concurrent_lru_action : public util::mempool::lru_default_action<benchmark_lru_data> {};
+
+typedef util::mempool::concurrent_lru_pool<uint32_t, benchmark_lru_data, benchmark_concurrent_lru_action> benchmark_concurrent_lru_pool_t;
+
+static void concurrent_lru_pool_benchmark_worker(benchmark_concurrent_lru_pool_t* pool, int loop, uint32_t key_num) {
+    std::vector<benchmark_lru_data*> holds;
+    holds.reserve(8);
+
+    for (int i = 0; i < loop; ++i) {
+        uint32_t key = static_cast<uint32_t>(i) % key_num;
+        for (int j = 0; j < 8; ++j) {
+            benchmark_lru_data* obj = pool->pull(key);
+            if (NULL == obj) {
+                obj = new benchmark_lru_data();
+                obj->key = key;
+            }
+            holds.push_back(obj);
+        }
+
+        for (size_t j = 0; j < holds.size(); ++j) {
+            if (!pool->push(key, holds[j])) {
+                delete holds[j];
+            }
+        }
+        holds.clear();
+    }
+}
+
+void LRUPoolBenchmark()
+{
+    puts("");
+    puts("===============begin lru pool benchmark==============");
+
+    typedef util::mempool::lru_pool<uint32_t, benchmark_lru_data, benchmark_lru_action> std_pool_t;
+    typedef util::mempool::lru_pool<uint32_t, benchmark_lru_data, benchmark_lru_action, util::mempool::lru_slab_list_storage<> > slab_pool_t;
+
+    double std_ms = lru_pool_benchmark_push_pull<std_pool_t>(2000, 256);
+    double slab_ms = lru_pool_benchmark_push_pull<slab_pool_t>(2000, 256);
+    std::cout<< "lru_pool push/pull 2000x256: std::list "<< std_ms<< "ms, slab "<< slab_ms<< "ms"<< std::endl;
+
+    const int loop = 20000;
+    for (int thread_num = 1; thread_num <= 8; thread_num *= 2) {
+        benchmark_concurrent_lru_pool_t pool;
+        pool.init(16, static_cast<size_t>(thread_num), 32);
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_num; ++i) {
+            threads.push_back(std::thread(concurrent_lru_pool_benchmark_worker, &pool, loop, 64));
+        }
+
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        long long cost_us = benchmark_cost_us(begin, end);
+        long long ops = static_cast<long long>(thread_num) * loop * 8 * 2;
+        std::cout<< "concurrent_lru_pool "<< thread_num<< " threads: "<< ops<< " push/pull in "<< cost_us<< "us, "
+            << (cost_us > 0 ? ops * 1000 / cost_us : 0)<< " ops/ms"<< std::endl;
+
+        pool.clear();
+    }
+
+    puts("===============end lru pool benchmark==============");
+}
+//=======================================================================================================
+
+//=======================================================================================================
+template<typename TLock>
+static void lock_benchmark_contention(const char* name, size_t thread_num, size_t loop_times)
+{
+    TLock lock;
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < thread_num; ++i) {
+        threads.push_back(std::thread([&lock, &counter, loop_times]() {
+            for (size_t j = 0; j < loop_times; ++j) {
+                util::lock::LockHolder<TLock> holder(lock);
+                ++counter;
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    std::cout<< name<< " with "<< thread_num<< " threads: "<< counter<< " lock/unlock in "<< benchmark_cost_us(begin, end)<< "us"<< std::endl;
+}
+
+void LockBenchmark()
+{
+    puts("");
+    puts("===============begin lock benchmark==============");
+
+    for (size_t thread_num = 2; thread_num <= 64; thread_num *= 2) {
+        size_t loop_times = 32768 / thread_num;
+        lock_benchmark_contention<util::lock::SpinLock>("SpinLock", thread_num, loop_times);
+        lock_benchmark_contention<util::lock::TTASSpinLock>("TTASSpinLock", thread_num, loop_times);
+        lock_benchmark_contention<util::lock::TicketLock>("TicketLock", thread_num, loop_times);
+        lock_benchmark_contention<util::lock::MCSLock>("MCSLock", thread_num, loop_times);
+        lock_benchmark_contention<util::lock::FutexLock>("FutexLock", thread_num, loop_times);
+    }
+
+    puts("===============end lock benchmark==============");
+}
+//=======================================================================================================
+
+//=======================================================================================================
+static void ring_queue_benchmark_mpmc(size_t producer_num, size_t consumer_num, size_t loop_times)
+{
+    util::ds::mpmc_ring_queue<size_t> queue(1024);
+    std::atomic<size_t> pop_count;
+    pop_count.store(0);
+
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < producer_num; ++i) {
+        threads.push_back(std::thread([&queue, loop_times]() {
+            for (size_t j = 1; j <= loop_times; ++j) {
+                while (!queue.try_push(j)) {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    size_t total = producer_num * loop_times;
+    for (size_t i = 0; i < consumer_num; ++i) {
+        threads.push_back(std::thread([&queue, &pop_count, total]() {
+            size_t v;
+            while (pop_count.load(std::memory_order_relaxed) < total) {
+                if (queue.try_pop(v)) {
+                    pop_count.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    std::cout<< "mpmc_ring_queue "<< producer_num<< "P"<< consumer_num<< "C: "<< total<< " push/pop in "
+        << benchmark_cost_us(begin, end)<< "us"<< std::endl;
+}
+
+static void ring_queue_benchmark_spsc(size_t loop_times, size_t batch_size)
+{
+    util::ds::spsc_ring_queue<size_t> queue(1024);
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::thread producer([&queue, loop_times, batch_size]() {
+        std::vector<size_t> buf(batch_size);
+        size_t next = 1;
+        while (next <= loop_times) {
+            size_t n = 0;
+            for (; n < batch_size && next + n <= loop_times; ++n) {
+                buf[n] = next + n;
+            }
+
+            size_t pushed = queue.push_n(&buf[0], &buf[0] + n);
+            next += pushed;
+            if (0 == pushed) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::thread consumer([&queue, loop_times, batch_size]() {
+        std::vector<size_t> buf(batch_size);
+        size_t count = 0;
+        while (count < loop_times) {
+            size_t n = queue.pop_n(&buf[0], batch_size);
+            count += n;
+            if (0 == n) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    std::cout<< "spsc_ring_queue 1P1C batch "<< batch_size<< ": "<< loop_times<< " push/pop in "
+        << benchmark_cost_us(begin, end)<< "us"<< std::endl;
+}
+
+void RingQueueBenchmark()
+{
+    puts("");
+    puts("===============begin ring queue benchmark==============");
+
+    ring_queue_benchmark_mpmc(1, 1, 65536);
+    ring_queue_benchmark_mpmc(4, 4, 16384);
+    ring_queue_benchmark_mpmc(16, 16, 4096);
+
+    ring_queue_benchmark_spsc(1 << 20, 1);
+    ring_queue_benchmark_spsc(1 << 20, 64);
+
+    puts("===============end ring queue benchmark==============");
+}
+//=======================================================================================================
+
+//=======================================================================================================
+void LogBenchmark()
+{
+    puts("");
+    puts("===============begin log benchmark==============");
+
+    util::log::LogWrapper* logger = WLOG_GETCAT(1);
+    logger->init(util::log::LogWrapper::level_t::LOG_LW_INFO);
+    logger->addLogHandle([](util::log::LogWrapper::level_t::type, const char*, const char*) {});
+
+    const int loop_times = 100000;
+
+    // 低于运行时级别的语句
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_times * 100; ++i) {
+        WCLOGDEBUG(1, "benchmark %d", i);
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    std::cout<< "filtered log: "<< static_cast<double>(benchmark_cost_us(begin, end)) * 10.0 / loop_times<< "ns per call"<< std::endl;
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_times * 10; ++i) {
+        util::log::LogWrapper::update();
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout<< "LogWrapper::update: "<< static_cast<double>(benchmark_cost_us(begin, end)) * 100.0 / loop_times<< "ns per call"<< std::endl;
+
+    // 队列足够大，只统计调用线程的开销
+    logger->startAsync(static_cast<size_t>(loop_times) * 2);
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_times; ++i) {
+        WCLOGINFO(1, "benchmark %d %s %.2f", i, "text", 1.5);
+    }
+    std::chrono::steady_clock::time_point mid = std::chrono::steady_clock::now();
+    logger->flush();
+
+    std::chrono::steady_clock::time_point deferred_begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_times; ++i) {
+        WCLOGDEFERINFO(1, "benchmark %d %s %.2f", i, "text", 1.5);
+    }
+    end = std::chrono::steady_clock::now();
+    logger->stopAsync();
+
+    std::cout<< "async log: "<< static_cast<double>(benchmark_cost_us(begin, mid)) * 1000.0 / loop_times<< "ns per call, deferred log: "
+        << static_cast<double>(benchmark_cost_us(deferred_begin, end)) * 1000.0 / loop_times<< "ns per call"<< std::endl;
+
+    logger->clearLogHandle();
+
+    puts("===============end log benchmark==============");
+}
+//=======================================================================================================
+
+int main(int argc, char** argv)
+{
+    LRUPoolBenchmark();
+    LockBenchmark();
+    RingQueueBenchmark();
+    LogBenchmark();
+    return 0;
+}
@@ -4,10 +4,15 @@
  * @note 使用了 c++11的atomic
  *       不支持的编译器就自求多福吧
  *
+ * @note push和pop返回的是槽位指针，返回时元素还没有写入（或已经可以被覆盖），
+ *       只能用于单线程或外部保证同步的场景；多线程之间传递数据请使用mpmc_ring_queue.h
+ *
  * @version 1.0
  * @author OWenT
  * @date 2015-01-09
  *
+ * @history
+ *     2016-06-07: 修复empty()的判断反了的问题，capacity()改为返回最大元素个数
  */
 #pragma once
 
@@ -145,7 +150,7 @@ namespace util {
             }
 
             bool empty() const {
-                return start_ != end_;
+                return start_ == end_;
             }
 
             size_t size() const {
@@ -154,7 +159,7 @@ namespace util {
 
 
             size_t capacity() const {
-                return data_.capacity();
+                return data_.size() - 1;
             }
 
         private:
@@ -0,0 +1,185 @@
+﻿/**
+ * @brief 有界多生产者多消费者无锁环形队列
+ * @note 容量在构造时确定，会向上取整到2的幂
+ * @note 每个槽位带一个序号：序号等于写入位置时可写，等于写入位置+1时可读，
+ *       读写双方都只在序号就绪后才访问数据，不会读到没有构造完的元素
+ * @note 元素按值保存，try_push时构造，try_pop时移出并析构
+ * @note 使用了 c++11的atomic
+ * @see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-07
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "std/explicit_declare.h"
+
+namespace util {
+    namespace ds {
+
+        template <typename T>
+        class mpmc_ring_queue {
+        public:
+            typedef T value_type;
+            typedef size_t size_type;
+
+        private:
+            mpmc_ring_queue(const mpmc_ring_queue&) FUNC_DELETE;
+            mpmc_ring_queue& operator=(const mpmc_ring_queue&) FUNC_DELETE;
+
+            struct slot_t {
+                std::atomic<size_t> seq;
+                typename std::aligned_storage<sizeof(value_type), std::alignment_of<value_type>::value>::type data;
+
+                inline value_type* get() { return reinterpret_cast<value_type*>(&data); }
+            };
+
+        public:
+            explicit mpmc_ring_queue(size_t capacity) : slots_(NULL), mask_(0) {
+                size_t real_cap = 2;
+                while (real_cap < capacity) {
+                    real_cap <<= 1;
+                }
+
+                slots_ = new slot_t[real_cap];
+                for (size_t i = 0; i < real_cap; ++i) {
+                    slots_[i].seq.store(i, std::memory_order_relaxed);
+                }
+                mask_ = real_cap - 1;
+
+                enqueue_pos_.store(0, std::memory_order_relaxed);
+                dequeue_pos_.store(0, std::memory_order_relaxed);
+            }
+
+            ~mpmc_ring_queue() {
+                // 析构时不会再有并发读写，已写入的槽位序号是写入位置+1
+                size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+                for (size_t pos = dequeue_pos_.load(std::memory_order_acquire); pos != tail; ++pos) {
+                    slot_t& slot = slots_[pos & mask_];
+                    if (slot.seq.load(std::memory_order_relaxed) == pos + 1) {
+                        slot.get()->~value_type();
+                    }
+                }
+
+                delete[] slots_;
+            }
+
+            /**
+             * @brief 写入一个元素
+             * @return 队列已满时返回false
+             */
+            bool try_push(const value_type& v) {
+                slot_t* slot = acquire_push_slot();
+                if (NULL == slot) {
+                    return false;
+                }
+
+                new (slot->get()) value_type(v);
+                commit_push_slot(slot);
+                return true;
+            }
+
+            bool try_push(value_type&& v) {
+                slot_t* slot = acquire_push_slot();
+                if (NULL == slot) {
+                    return false;
+                }
+
+                new (slot->get()) value_type(std::move(v));
+                commit_push_slot(slot);
+                return true;
+            }
+
+            /**
+             * @brief 读取一个元素
+             * @return 队列为空（或队首的生产者还没写完）时返回false
+             */
+            bool try_pop(value_type& v) {
+                size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+                slot_t* slot;
+                while (true) {
+                    slot = &slots_[pos & mask_];
+                    size_t seq = slot->seq.load(std::memory_order_acquire);
+                    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                    if (0 == dif) {
+                        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    } else if (dif < 0) {
+                        return false;
+                    } else {
+                        pos = dequeue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+
+                value_type* data = slot->get();
+                v = std::move(*data);
+                data->~value_type();
+
+                // 下一轮的写入位置
+                slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief 近似的元素个数，有并发读写时只是参考值
+             */
+            size_t size() const {
+                size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+                size_t head = dequeue_pos_.load(std::memory_order_acquire);
+                return tail > head ? tail - head : 0;
+            }
+
+            bool empty() const {
+                return 0 == size();
+            }
+
+            size_t capacity() const {
+                return mask_ + 1;
+            }
+
+        private:
+            slot_t* acquire_push_slot() {
+                size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+                while (true) {
+                    slot_t* slot = &slots_[pos & mask_];
+                    size_t seq = slot->seq.load(std::memory_order_acquire);
+                    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if (0 == dif) {
+                        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return slot;
+                        }
+                    } else if (dif < 0) {
+                        return NULL;
+                    } else {
+                        pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // 抢到槽位时序号等于写入位置，+1后消费者可读
+            void commit_push_slot(slot_t* slot) {
+                slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+
+        private:
+            slot_t* slots_;
+            size_t mask_;
+            // 生产者和消费者的位置分开放，避免伪共享
+            char padding0_[64];
+            std::atomic<size_t> enqueue_pos_;
+            char padding1_[64];
+            std::atomic<size_t> dequeue_pos_;
+            char padding2_[64];
+        };
+    }
+}
@@ -0,0 +1,206 @@
+﻿/**
+ * @brief 有界单生产者单消费者无锁环形队列
+ * @note 容量在构造时确定，会向上取整到2的幂，下标用掩码计算
+ * @note 只能有一个线程写入、一个线程读取，读写都不需要CAS
+ * @note 写入位置和读取位置各占一个缓存行；双方各自缓存对方的位置，只有缓存的值显示队列满（空）时才重新读取对方的缓存行
+ * @note 批量接口只发布一次位置，适合高吞吐的数据传递
+ * @note 使用了 c++11的atomic
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-07
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "std/explicit_declare.h"
+
+namespace util {
+    namespace ds {
+
+        template <typename T>
+        class spsc_ring_queue {
+        public:
+            typedef T value_type;
+            typedef size_t size_type;
+
+        private:
+            spsc_ring_queue(const spsc_ring_queue&) FUNC_DELETE;
+            spsc_ring_queue& operator=(const spsc_ring_queue&) FUNC_DELETE;
+
+            typedef typename std::aligned_storage<sizeof(value_type), std::alignment_of<value_type>::value>::type slot_t;
+
+            inline value_type* at(size_t pos) { return reinterpret_cast<value_type*>(&slots_[pos & mask_]); }
+
+        public:
+            explicit spsc_ring_queue(size_t capacity) : slots_(NULL), mask_(0), cached_head_(0), cached_tail_(0) {
+                size_t real_cap = 2;
+                while (real_cap < capacity) {
+                    real_cap <<= 1;
+                }
+
+                slots_ = new slot_t[real_cap];
+                mask_ = real_cap - 1;
+
+                tail_.store(0, std::memory_order_relaxed);
+                head_.store(0, std::memory_order_relaxed);
+            }
+
+            ~spsc_ring_queue() {
+                size_t tail = tail_.load(std::memory_order_acquire);
+                for (size_t pos = head_.load(std::memory_order_acquire); pos != tail; ++pos) {
+                    at(pos)->~value_type();
+                }
+
+                delete[] slots_;
+            }
+
+            // ============ 生产者 ============
+            /**
+             * @brief 写入一个元素
+             * @return 队列已满时返回false
+             */
+            bool try_push(const value_type& v) {
+                size_t tail = tail_.load(std::memory_order_relaxed);
+                if (0 == writable(tail, 1)) {
+                    return false;
+                }
+
+                new (at(tail)) value_type(v);
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool try_push(value_type&& v) {
+                size_t tail = tail_.load(std::memory_order_relaxed);
+                if (0 == writable(tail, 1)) {
+                    return false;
+                }
+
+                new (at(tail)) value_type(std::move(v));
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief 批量写入，只写入队列剩余空间能放下的部分
+             * @return 写入的个数
+             */
+            template<typename TIter>
+            size_t push_n(TIter begin, TIter end) {
+                size_t tail = tail_.load(std::memory_order_relaxed);
+                size_t n = writable(tail, static_cast<size_t>(std::distance(begin, end)));
+
+                for (size_t i = 0; i < n; ++i, ++begin) {
+                    new (at(tail + i)) value_type(*begin);
+                }
+
+                if (n > 0) {
+                    tail_.store(tail + n, std::memory_order_release);
+                }
+                return n;
+            }
+
+            // ============ 消费者 ============
+            /**
+             * @brief 读取一个元素
+             * @return 队列为空时返回false
+             */
+            bool try_pop(value_type& v) {
+                size_t head = head_.load(std::memory_order_relaxed);
+                if (0 == readable(head, 1)) {
+                    return false;
+                }
+
+                value_type* data = at(head);
+                v = std::move(*data);
+                data->~value_type();
+                head_.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief 批量读取
+             * @param out 输出数组，至少有n个元素
+             * @return 读取的个数
+             */
+            size_t pop_n(value_type* out, size_t n) {
+                size_t head = head_.load(std::memory_order_relaxed);
+                n = readable(head, n);
+
+                for (size_t i = 0; i < n; ++i) {
+                    value_type* data = at(head + i);
+                    out[i] = std::move(*data);
+                    data->~value_type();
+                }
+
+                if (n > 0) {
+                    head_.store(head + n, std::memory_order_release);
+                }
+                return n;
+            }
+
+            /**
+             * @brief 近似的元素个数，在读写线程以外调用时只是参考值
+             */
+            size_t size() const {
+                size_t tail = tail_.load(std::memory_order_acquire);
+                size_t head = head_.load(std::memory_order_acquire);
+                return tail > head ? tail - head : 0;
+            }
+
+            bool empty() const {
+                return 0 == size();
+            }
+
+            size_t capacity() const {
+                return mask_ + 1;
+            }
+
+        private:
+            // 生产者调用，先用缓存的读取位置计算，不够时再读取消费者的缓存行
+            size_t writable(size_t tail, size_t n) {
+                size_t left = mask_ + 1 - (tail - cached_head_);
+                if (left < n) {
+                    cached_head_ = head_.load(std::memory_order_acquire);
+                    left = mask_ + 1 - (tail - cached_head_);
+                }
+
+                return left < n ? left : n;
+            }
+
+            // 消费者调用，先用缓存的写入位置计算，不够时再读取生产者的缓存行
+            size_t readable(size_t head, size_t n) {
+                size_t left = cached_tail_ - head;
+                if (left < n) {
+                    cached_tail_ = tail_.load(std::memory_order_acquire);
+                    left = cached_tail_ - head;
+                }
+
+                return left < n ? left : n;
+            }
+
+        private:
+            slot_t* slots_;
+            size_t mask_;
+
+            // 生产者使用的缓存行
+            char padding0_[64];
+            std::atomic<size_t> tail_;
+            size_t cached_head_;
+
+            // 消费者使用的缓存行
+            char padding1_[64];
+            std::atomic<size_t> head_;
+            size_t cached_tail_;
+            char padding2_[64];
+        };
+    }
+}
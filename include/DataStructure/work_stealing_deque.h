@@ -0,0 +1,181 @@
+﻿/**
+ * @brief 用于任务窃取的无锁双端队列(Chase-Lev)
+ * @note 只有队列所有者可以调用push和pop（在底部后进先出），其他线程调用steal从顶部先进先出地窃取
+ * @note 顶部位置只增不减，窃取和所有者取最后一个元素时都通过CAS顶部位置竞争，没有ABA问题
+ * @note 空间不足时所有者把数组扩容为两倍；窃取者可能还在读旧数组，所以旧数组保留到队列析构时再释放
+ * @note 元素通过std::atomic<T>读写，T必须可以平凡复制，一般保存任务指针
+ * @note 使用了 c++11的atomic
+ * @see Chase and Lev, Dynamic Circular Work-Stealing Deque, SPAA 2005
+ * @see Le, Pop, Cohen and Zappa Nardelli, Correct and Efficient Work-Stealing for Weak Memory Models, PPoPP 2013
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-07
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+#include "std/explicit_declare.h"
+
+namespace util {
+    namespace ds {
+
+        template <typename T>
+        class work_stealing_deque {
+        public:
+            typedef T value_type;
+            typedef size_t size_type;
+
+        private:
+            work_stealing_deque(const work_stealing_deque&) FUNC_DELETE;
+            work_stealing_deque& operator=(const work_stealing_deque&) FUNC_DELETE;
+
+            struct buffer_t {
+                int64_t mask;
+                buffer_t* prev; // 扩容前的数组，析构时释放
+                std::atomic<value_type>* data;
+
+                explicit buffer_t(int64_t cap) : mask(cap - 1), prev(NULL), data(new std::atomic<value_type>[static_cast<size_t>(cap)]) {}
+                ~buffer_t() { delete[] data; }
+
+                inline value_type get(int64_t i) const { return data[i & mask].load(std::memory_order_relaxed); }
+                inline void put(int64_t i, const value_type& v) { data[i & mask].store(v, std::memory_order_relaxed); }
+            };
+
+        public:
+            /**
+             * @param capacity 初始容量，会向上取整到2的幂
+             */
+            explicit work_stealing_deque(size_t capacity = 64) {
+                int64_t real_cap = 2;
+                while (real_cap < static_cast<int64_t>(capacity)) {
+                    real_cap <<= 1;
+                }
+
+                top_.store(0, std::memory_order_relaxed);
+                bottom_.store(0, std::memory_order_relaxed);
+                buffer_.store(new buffer_t(real_cap), std::memory_order_relaxed);
+            }
+
+            ~work_stealing_deque() {
+                buffer_t* buf = buffer_.load(std::memory_order_relaxed);
+                while (NULL != buf) {
+                    buffer_t* prev = buf->prev;
+                    delete buf;
+                    buf = prev;
+                }
+            }
+
+            // ============ 所有者 ============
+            /**
+             * @brief 在底部放入一个元素，空间不足时扩容
+             * @note 只能由所有者线程调用
+             */
+            void push(const value_type& v) {
+                int64_t b = bottom_.load(std::memory_order_relaxed);
+                int64_t t = top_.load(std::memory_order_acquire);
+                buffer_t* buf = buffer_.load(std::memory_order_relaxed);
+                if (b - t > buf->mask) {
+                    buf = grow(buf, b, t);
+                }
+
+                buf->put(b, v);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief 从底部取出一个元素
+             * @note 只能由所有者线程调用
+             * @return 队列为空或最后一个元素被窃取时返回false
+             */
+            bool pop(value_type& v) {
+                int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+                buffer_t* buf = buffer_.load(std::memory_order_relaxed);
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top_.load(std::memory_order_relaxed);
+
+                if (t > b) {
+                    // 已经空了
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                v = buf->get(b);
+                if (t < b) {
+                    return true;
+                }
+
+                // 最后一个元素，和窃取者竞争
+                bool ret = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return ret;
+            }
+
+            // ============ 窃取者 ============
+            /**
+             * @brief 从顶部窃取一个元素，任意线程都可以调用
+             * @return 队列为空或和其他线程竞争失败时返回false
+             */
+            bool steal(value_type& v) {
+                int64_t t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t b = bottom_.load(std::memory_order_acquire);
+                if (t >= b) {
+                    return false;
+                }
+
+                buffer_t* buf = buffer_.load(std::memory_order_acquire);
+                value_type ret = buf->get(t);
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return false;
+                }
+
+                v = ret;
+                return true;
+            }
+
+            /**
+             * @brief 近似的元素个数，有并发操作时只是参考值
+             */
+            size_t size() const {
+                int64_t b = bottom_.load(std::memory_order_relaxed);
+                int64_t t = top_.load(std::memory_order_relaxed);
+                return b > t ? static_cast<size_t>(b - t) : 0;
+            }
+
+            bool empty() const {
+                return 0 == size();
+            }
+
+            size_t capacity() const {
+                return static_cast<size_t>(buffer_.load(std::memory_order_relaxed)->mask + 1);
+            }
+
+        private:
+            buffer_t* grow(buffer_t* old, int64_t b, int64_t t) {
+                buffer_t* buf = new buffer_t((old->mask + 1) * 2);
+                for (int64_t i = t; i < b; ++i) {
+                    buf->put(i, old->get(i));
+                }
+
+                buf->prev = old;
+                buffer_.store(buf, std::memory_order_release);
+                return buf;
+            }
+
+        private:
+            // 窃取者竞争的顶部和所有者独占的底部分开放，避免伪共享
+            std::atomic<int64_t> top_;
+            char padding0_[64];
+            std::atomic<int64_t> bottom_;
+            std::atomic<buffer_t*> buffer_;
+            char padding1_[64];
+        };
+    }
+}
@@ -13,6 +13,7 @@
  * @history
  *   2012.07.20 为线程安全而改进实现方式
  *   2015.01.10 改为使用双检锁实现线程安全
+ *   2016.06.06 增加锁类型模板参数，初始化比较慢时可以使用FutexLock等会挂起的锁
  *
  */
 
@@ -43,7 +44,7 @@ namespace wrapper
 
 }
 
-template <typename T>
+template <typename T, typename TLock = util::lock::SpinLock>
 class Singleton : public Noncopyable
 {
 public:
@@ -52,6 +53,7 @@ public:
      */
     typedef T self_type;
     typedef std::shared_ptr<self_type> ptr_t;
+    typedef TLock lock_type;
 
 protected:
 
@@ -101,7 +103,7 @@ public:
     {
         static ptr_t inst;
         if (!inst) {
-            static util::lock::SpinLock lock;
+            static lock_type lock;
             lock.Lock();
 
             do
@@ -0,0 +1,152 @@
+﻿/**
+ * @file FutexLock.h
+ * @brief 先自旋后挂起的混合锁
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-06
+ *
+ * @note 短暂自旋后在futex上挂起，解锁时只在有等待者时唤醒一个，不会像SpinLock那样sleep一整个毫秒
+ * @note 状态：0=未加锁，1=已加锁且没有等待者，2=已加锁且可能有等待者
+ * @note 非Linux平台使用mutex+condition_variable模拟futex的等待和唤醒
+ * @note 接口和SpinLock一致，可以直接用于LockHolder和Singleton
+ * @note 使用了 c++11的atomic
+ * @see Ulrich Drepper, Futexes Are Tricky
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_FUTEXLOCK_H_
+#define _UTIL_LOCK_FUTEXLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+
+#if defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #define __UTIL_LOCK_FUTEXLOCK_LINUX_FUTEX 1
+#else
+    #include <condition_variable>
+    #include <mutex>
+#endif
+
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class FutexLock
+        {
+        public:
+          // 挂起前自旋的次数
+          enum { SPIN_TIMES = 128 };
+
+        private:
+          typedef enum {Unlocked = 0, Locked = 1, Contended = 2} LockState;
+          ::std::atomic<int> m_iStatus;
+
+        #ifndef __UTIL_LOCK_FUTEXLOCK_LINUX_FUTEX
+          ::std::mutex m_stParkMutex;
+          ::std::condition_variable m_stParkCond;
+        #endif
+
+          FutexLock(const FutexLock&);
+          FutexLock& operator=(const FutexLock&);
+
+          // 状态仍然是Contended时挂起，被唤醒或状态已变化时返回
+          void Park()
+          {
+          #ifdef __UTIL_LOCK_FUTEXLOCK_LINUX_FUTEX
+              syscall(SYS_futex, reinterpret_cast<int*>(&m_iStatus), FUTEX_WAIT_PRIVATE, static_cast<int>(Contended), NULL, NULL, 0);
+          #else
+              ::std::unique_lock< ::std::mutex> guard(m_stParkMutex);
+              while (m_iStatus.load(::std::memory_order_acquire) == Contended)
+                  m_stParkCond.wait(guard);
+          #endif
+          }
+
+          void WakeOne()
+          {
+          #ifdef __UTIL_LOCK_FUTEXLOCK_LINUX_FUTEX
+              syscall(SYS_futex, reinterpret_cast<int*>(&m_iStatus), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+          #else
+              // 持有mutex再通知，等待者检查状态和开始等待之间不会丢失唤醒
+              ::std::lock_guard< ::std::mutex> guard(m_stParkMutex);
+              m_stParkCond.notify_one();
+          #endif
+          }
+
+        public:
+          FutexLock() {
+              m_iStatus.store(Unlocked);
+          }
+
+          void Lock()
+          {
+              int expected = Unlocked;
+              if (m_iStatus.compare_exchange_strong(expected, static_cast<int>(Locked), ::std::memory_order_acquire, ::std::memory_order_relaxed))
+                  return;
+
+              LockSlow();
+          }
+
+          void Unlock()
+          {
+              // 只有可能有等待者时才进入内核
+              if (m_iStatus.exchange(static_cast<int>(Unlocked), ::std::memory_order_release) == Contended)
+                  WakeOne();
+          }
+
+          bool IsLocked()
+          {
+              return m_iStatus.load(::std::memory_order_acquire) != Unlocked;
+          }
+
+          bool TryLock()
+          {
+              int expected = Unlocked;
+              return m_iStatus.compare_exchange_strong(expected, static_cast<int>(Locked), ::std::memory_order_acquire, ::std::memory_order_relaxed);
+          }
+
+          bool TryUnlock()
+          {
+              if (!IsLocked())
+                  return false;
+
+              Unlock();
+              return true;
+          }
+
+        private:
+          void LockSlow()
+          {
+              // 先自旋，只读等待，锁空闲后再尝试加锁
+              for (unsigned int i = 0; i < SPIN_TIMES; ++i)
+              {
+                  int status = m_iStatus.load(::std::memory_order_relaxed);
+                  if (Unlocked == status && TryLock())
+                      return;
+
+                  // 已经有挂起的等待者，继续自旋也拿不到锁
+                  if (Contended == status)
+                      break;
+
+                  __UTIL_LOCK_SPIN_LOCK_PAUSE();
+              }
+
+              // 以Contended状态获得锁，保证解锁时会唤醒其他等待者
+              while (m_iStatus.exchange(static_cast<int>(Contended), ::std::memory_order_acquire) != Unlocked)
+                  Park();
+          }
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_FUTEXLOCK_H_ */
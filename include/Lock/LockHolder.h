@@ -10,6 +10,7 @@
  * @note 实现锁的自管理操作
  *
  * @history
+ *     2016-06-05: 增加读写锁的读锁动作
  */
 
 #ifndef _UTIL_LOCK_LOCK_HOLDER_H_
@@ -63,6 +64,35 @@ namespace util
                     return lock.TryUnlock();
                 }
             };
+
+            // 读写锁的读锁
+            template<typename TLock>
+            struct DefaultReadLockAction
+            {
+                bool operator()(TLock& lock) const
+                {
+                    lock.ReadLock();
+                    return true;
+                }
+            };
+
+            template<typename TLock>
+            struct DefaultTryReadLockAction
+            {
+                bool operator()(TLock& lock) const
+                {
+                    return lock.TryReadLock();
+                }
+            };
+
+            template<typename TLock>
+            struct DefaultReadUnlockAction
+            {
+                void operator()(TLock& lock) const
+                {
+                    lock.ReadUnlock();
+                }
+            };
         }
 
         template<typename TLock,
@@ -0,0 +1,173 @@
+﻿/**
+ * @file MCSLock.h
+ * @brief MCS队列自旋锁（K42变种）
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-04
+ *
+ * @note 等待者在自己栈上的节点自旋，锁释放时只写下一个等待者的节点，竞争时没有缓存行来回颠簸
+ * @note K42变种不需要调用者传入队列节点，所以接口和SpinLock一致，可以直接用于LockHolder
+ * @note 使用了 c++11的atomic
+ * @see Scott, Shared-Memory Synchronization, 4.3.2
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_MCSLOCK_H_
+#define _UTIL_LOCK_MCSLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class MCSLock
+        {
+        private:
+          struct QNode
+          {
+              // 等待者节点上用于自旋的标记，锁本身的节点上表示队尾
+              ::std::atomic<QNode*> tail;
+              ::std::atomic<QNode*> next;
+          };
+
+          QNode m_stNode;
+
+          MCSLock(const MCSLock&);
+          MCSLock& operator=(const MCSLock&);
+
+          static QNode* Waiting() { return reinterpret_cast<QNode*>(static_cast<size_t>(1)); }
+
+          template<typename TPred>
+          static void SpinUntil(TPred pred)
+          {
+              unsigned int try_times = 0;
+              while (!pred())
+              {
+                  if (try_times < 64)
+                  {
+                      ++try_times;
+                      __UTIL_LOCK_SPIN_LOCK_PAUSE();
+                  }
+                  else
+                  {
+                      __UTIL_LOCK_SPIN_LOCK_THREAD_YIELD();
+                  }
+              }
+          }
+
+          struct NodeReady
+          {
+              QNode* node;
+              bool operator()() const { return Waiting() != node->tail.load(::std::memory_order_acquire); }
+          };
+
+          struct NextReady
+          {
+              QNode* node;
+              bool operator()() const { return NULL != node->next.load(::std::memory_order_acquire); }
+          };
+
+        public:
+          MCSLock() {
+              m_stNode.tail.store(NULL);
+              m_stNode.next.store(NULL);
+          }
+
+          void Lock()
+          {
+              while (true)
+              {
+                  QNode* prev = m_stNode.tail.load(::std::memory_order_acquire);
+                  if (NULL == prev)
+                  {
+                      // 没有持有者，直接把队尾设为锁本身
+                      if (m_stNode.tail.compare_exchange_strong(prev, &m_stNode, ::std::memory_order_acq_rel))
+                          return;
+
+                      continue;
+                  }
+
+                  QNode self;
+                  self.tail.store(Waiting(), ::std::memory_order_relaxed);
+                  self.next.store(NULL, ::std::memory_order_relaxed);
+                  if (!m_stNode.tail.compare_exchange_strong(prev, &self, ::std::memory_order_acq_rel))
+                      continue;
+
+                  prev->next.store(&self, ::std::memory_order_release);
+                  NodeReady ready = { &self };
+                  SpinUntil(ready);
+
+                  // 已经获得锁，把后继转移到锁节点上，之后self就不再被引用
+                  QNode* succ = self.next.load(::std::memory_order_acquire);
+                  if (NULL == succ)
+                  {
+                      m_stNode.next.store(NULL, ::std::memory_order_relaxed);
+                      QNode* expected = &self;
+                      if (!m_stNode.tail.compare_exchange_strong(expected, &m_stNode, ::std::memory_order_acq_rel))
+                      {
+                          NextReady next_ready = { &self };
+                          SpinUntil(next_ready);
+                          m_stNode.next.store(self.next.load(::std::memory_order_acquire), ::std::memory_order_release);
+                      }
+                  }
+                  else
+                  {
+                      m_stNode.next.store(succ, ::std::memory_order_release);
+                  }
+                  return;
+              }
+          }
+
+          void Unlock()
+          {
+              QNode* succ = m_stNode.next.load(::std::memory_order_acquire);
+              if (NULL == succ)
+              {
+                  QNode* expected = &m_stNode;
+                  if (m_stNode.tail.compare_exchange_strong(expected, NULL, ::std::memory_order_acq_rel))
+                      return;
+
+                  // 有新的等待者正在入队
+                  NextReady next_ready = { &m_stNode };
+                  SpinUntil(next_ready);
+                  succ = m_stNode.next.load(::std::memory_order_acquire);
+              }
+
+              succ->tail.store(NULL, ::std::memory_order_release);
+          }
+
+          bool IsLocked()
+          {
+              return NULL != m_stNode.tail.load(::std::memory_order_acquire);
+          }
+
+          bool TryLock()
+          {
+              QNode* expected = NULL;
+              return m_stNode.tail.compare_exchange_strong(expected, &m_stNode, ::std::memory_order_acq_rel);
+          }
+
+          bool TryUnlock()
+          {
+              if (!IsLocked())
+                  return false;
+
+              Unlock();
+              return true;
+          }
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_MCSLOCK_H_ */
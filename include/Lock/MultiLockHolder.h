@@ -0,0 +1,222 @@
+﻿/**
+ * @file MultiLockHolder.h
+ * @brief 同时持有多个锁的锁管理器
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-06
+ *
+ * @note 按锁的地址顺序加锁，第一个锁阻塞等待，后面的锁只TryLock；
+ *       失败时释放已持有的全部锁、退避后重试，等待时最多只持有一个锁，不会死锁也不会让其他线程排队等在已持有的锁上
+ * @note 同一个锁传入多次时只加锁一次，有任何一处是独占模式就按独占模式加锁
+ * @note 模板参数直接写锁类型表示独占模式（Lock/TryLock/Unlock），写SharedLock<TLock>表示共享模式（ReadLock/TryReadLock/ReadUnlock）
+ * @note 使用了 c++11的变长模板参数
+ *
+ * @example
+ *     util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SpinLock> holder(from_lock, to_lock);
+ *     util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SharedLock<util::lock::RWSpinLock> > holder(lock, rw_lock);
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_MULTI_LOCK_HOLDER_H_
+#define _UTIL_LOCK_MULTI_LOCK_HOLDER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <cstddef>
+
+#include "DesignPattern/Noncopyable.h"
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        /**
+         * @brief 独占模式，和直接写锁类型一样
+         */
+        template<typename TLock>
+        struct ExclusiveLock {};
+
+        /**
+         * @brief 共享模式，用于读写锁的读锁
+         */
+        template<typename TLock>
+        struct SharedLock {};
+
+        namespace detail
+        {
+            template<typename TArg>
+            struct MultiLockTraits
+            {
+                typedef TArg lock_type;
+                static const bool is_exclusive = true;
+
+                static void Lock(lock_type& lock) { lock.Lock(); }
+                static bool TryLock(lock_type& lock) { return lock.TryLock(); }
+                static void Unlock(lock_type& lock) { lock.Unlock(); }
+            };
+
+            template<typename TLock>
+            struct MultiLockTraits<ExclusiveLock<TLock> > : public MultiLockTraits<TLock> {};
+
+            template<typename TLock>
+            struct MultiLockTraits<SharedLock<TLock> >
+            {
+                typedef TLock lock_type;
+                static const bool is_exclusive = false;
+
+                static void Lock(lock_type& lock) { lock.ReadLock(); }
+                static bool TryLock(lock_type& lock) { return lock.TryReadLock(); }
+                static void Unlock(lock_type& lock) { lock.ReadUnlock(); }
+            };
+
+            /**
+             * @brief 擦除了类型的锁，用于按地址排序
+             */
+            struct MultiLockEntry
+            {
+                void* lock;
+                bool exclusive;
+                void (*lock_fn)(void*);
+                bool (*try_lock_fn)(void*);
+                void (*unlock_fn)(void*);
+            };
+
+            template<typename TArg>
+            struct MultiLockEntryMaker
+            {
+                typedef MultiLockTraits<TArg> traits_type;
+                typedef typename traits_type::lock_type lock_type;
+
+                static void Lock(void* lock) { traits_type::Lock(*static_cast<lock_type*>(lock)); }
+                static bool TryLock(void* lock) { return traits_type::TryLock(*static_cast<lock_type*>(lock)); }
+                static void Unlock(void* lock) { traits_type::Unlock(*static_cast<lock_type*>(lock)); }
+
+                static MultiLockEntry Make(lock_type& lock)
+                {
+                    MultiLockEntry ret;
+                    ret.lock = &lock;
+                    ret.exclusive = traits_type::is_exclusive;
+                    ret.lock_fn = &Lock;
+                    ret.try_lock_fn = &TryLock;
+                    ret.unlock_fn = &Unlock;
+                    return ret;
+                }
+            };
+        }
+
+        template<typename... TArgs>
+        class MultiLockHolder : public Noncopyable
+        {
+        public:
+            enum { LOCK_NUM = sizeof...(TArgs) };
+
+            MultiLockHolder(typename detail::MultiLockTraits<TArgs>::lock_type&... locks): m_uLockNum(0)
+            {
+                detail::MultiLockEntry entries[LOCK_NUM + 1] = { detail::MultiLockEntryMaker<TArgs>::Make(locks)... };
+                for (size_t i = 0; i < static_cast<size_t>(LOCK_NUM); ++i)
+                {
+                    AddEntry(entries[i]);
+                }
+
+                LockAll();
+            }
+
+            ~MultiLockHolder()
+            {
+                UnlockAll();
+            }
+
+            bool IsAvailable() const {
+                return true;
+            }
+
+            /**
+             * @brief 去重后实际持有的锁的数量
+             */
+            size_t size() const {
+                return m_uLockNum;
+            }
+
+        private:
+            // 按地址插入排序，同一个锁合并
+            void AddEntry(const detail::MultiLockEntry& entry)
+            {
+                size_t pos = 0;
+                while (pos < m_uLockNum && reinterpret_cast<size_t>(m_stLocks[pos].lock) < reinterpret_cast<size_t>(entry.lock))
+                {
+                    ++pos;
+                }
+
+                if (pos < m_uLockNum && m_stLocks[pos].lock == entry.lock)
+                {
+                    if (entry.exclusive && !m_stLocks[pos].exclusive)
+                    {
+                        m_stLocks[pos] = entry;
+                    }
+                    return;
+                }
+
+                for (size_t i = m_uLockNum; i > pos; --i)
+                {
+                    m_stLocks[i] = m_stLocks[i - 1];
+                }
+                m_stLocks[pos] = entry;
+                ++m_uLockNum;
+            }
+
+            void LockAll()
+            {
+                if (0 == m_uLockNum)
+                {
+                    return;
+                }
+
+                unsigned int try_times = 0;
+                while (true)
+                {
+                    m_stLocks[0].lock_fn(m_stLocks[0].lock);
+
+                    size_t locked = 1;
+                    while (locked < m_uLockNum && m_stLocks[locked].try_lock_fn(m_stLocks[locked].lock))
+                    {
+                        ++locked;
+                    }
+
+                    if (locked == m_uLockNum)
+                    {
+                        return;
+                    }
+
+                    // 释放已持有的锁再退避，避免其他线程排队等在这些锁上
+                    for (size_t i = locked; i > 0; --i)
+                    {
+                        m_stLocks[i - 1].unlock_fn(m_stLocks[i - 1].lock);
+                    }
+
+                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times);
+                }
+            }
+
+            void UnlockAll()
+            {
+                for (size_t i = m_uLockNum; i > 0; --i)
+                {
+                    m_stLocks[i - 1].unlock_fn(m_stLocks[i - 1].lock);
+                }
+            }
+
+        private:
+            // 多一个元素，避免没有锁时定义长度为0的数组
+            detail::MultiLockEntry m_stLocks[LOCK_NUM + 1];
+            size_t m_uLockNum;
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_MULTI_LOCK_HOLDER_H_ */
@@ -0,0 +1,172 @@
+﻿/**
+ * @file RWSpinLock.h
+ * @brief 读写自旋锁
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-05
+ *
+ * @note 写优先：有写者等待时新的读者会等待，避免写者饿死
+ * @note 读计数按线程分片，每个分片独占一个缓存行，读者之间不会互相争抢缓存行
+ * @note 读锁必须在加锁的线程上解锁（解锁时要找到同一个分片）
+ * @note Lock/Unlock/TryLock是写锁，所以默认的LockHolder就是写锁；读锁使用LockHolder.h里的DefaultReadLockAction等
+ * @note 使用了 c++11的atomic
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_RWSPINLOCK_H_
+#define _UTIL_LOCK_RWSPINLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+#include "SpinLock.h"
+#include "seq_alloc.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class RWSpinLock
+        {
+        public:
+          enum { SHARD_NUM = 16 };
+
+        private:
+          typedef enum {Unlocked = 0, Locked = 1} LockState;
+
+          struct ReaderShard
+          {
+              ::std::atomic<int> count;
+              char padding[64 - sizeof(::std::atomic<int>)];
+          };
+
+          ::std::atomic_uint m_enWriter;
+          char m_szPadding[64 - sizeof(::std::atomic_uint)];
+          ReaderShard m_stReaders[SHARD_NUM];
+
+          RWSpinLock(const RWSpinLock&);
+          RWSpinLock& operator=(const RWSpinLock&);
+
+          ReaderShard& GetShard()
+          {
+              return m_stReaders[seq_alloc_thread_shard_index() % SHARD_NUM];
+          }
+
+          bool HasReader()
+          {
+              for (int i = 0; i < SHARD_NUM; ++i)
+              {
+                  if (0 != m_stReaders[i].count.load(::std::memory_order_seq_cst))
+                      return true;
+              }
+
+              return false;
+          }
+
+        public:
+          RWSpinLock() {
+              m_enWriter.store(Unlocked);
+              for (int i = 0; i < SHARD_NUM; ++i)
+                  m_stReaders[i].count.store(0);
+          }
+
+          // ============ 读锁 ============
+          void ReadLock()
+          {
+              unsigned int try_times = 0;
+              while (!TryReadLock())
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
+          }
+
+          bool TryReadLock()
+          {
+              if (m_enWriter.load(::std::memory_order_relaxed) == Locked)
+                  return false;
+
+              // 先增加读计数再检查写者，和写者的先设置标记再检查读计数对应，所以都需要seq_cst
+              ReaderShard& shard = GetShard();
+              shard.count.fetch_add(1, ::std::memory_order_seq_cst);
+              if (m_enWriter.load(::std::memory_order_seq_cst) == Locked)
+              {
+                  shard.count.fetch_sub(1, ::std::memory_order_release);
+                  return false;
+              }
+
+              return true;
+          }
+
+          void ReadUnlock()
+          {
+              GetShard().count.fetch_sub(1, ::std::memory_order_release);
+          }
+
+          // ============ 写锁 ============
+          void Lock()
+          {
+              unsigned int try_times = 0;
+              // 先抢占写者标记，之后新的读者都会等待
+              while (m_enWriter.load(::std::memory_order_relaxed) == Locked ||
+                  m_enWriter.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_seq_cst) == Locked)
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
+
+              // 等待已有的读者退出
+              try_times = 0;
+              while (HasReader())
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
+          }
+
+          void Unlock()
+          {
+              m_enWriter.store(static_cast<unsigned int>(Unlocked), ::std::memory_order_release);
+          }
+
+          bool TryLock()
+          {
+              if (m_enWriter.load(::std::memory_order_relaxed) == Locked)
+                  return false;
+
+              if (m_enWriter.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_seq_cst) == Locked)
+                  return false;
+
+              if (HasReader())
+              {
+                  Unlock();
+                  return false;
+              }
+
+              return true;
+          }
+
+          bool TryUnlock()
+          {
+              return m_enWriter.exchange(static_cast<unsigned int>(Unlocked), ::std::memory_order_acq_rel) == Locked;
+          }
+
+          /**
+           * @brief 是否有写者持有或等待
+           */
+          bool IsLocked()
+          {
+              return m_enWriter.load(::std::memory_order_acquire) == Locked;
+          }
+
+          /**
+           * @brief 是否有读者持有，只是近似值
+           */
+          bool IsReadLocked()
+          {
+              return HasReader();
+          }
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_RWSPINLOCK_H_ */
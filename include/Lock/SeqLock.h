@@ -0,0 +1,164 @@
+﻿/**
+ * @file SeqLock.h
+ * @brief 顺序锁
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-05
+ *
+ * @note 写者之间互斥，读者不加锁：读之前和读之后的序号一致且为偶数时读到的数据有效，否则重试
+ * @note 适合读多写少的小块POD数据，读者不会写任何共享缓存行
+ * @note Lock/Unlock/TryLock是写锁，可以直接用于LockHolder
+ * @note 使用了 c++11的atomic
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_SEQLOCK_H_
+#define _UTIL_LOCK_SEQLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class SeqLock
+        {
+        private:
+          ::std::atomic<uint32_t> m_uSequence;
+
+          SeqLock(const SeqLock&);
+          SeqLock& operator=(const SeqLock&);
+
+        public:
+          SeqLock() {
+              m_uSequence.store(0);
+          }
+
+          // ============ 读者 ============
+          /**
+           * @brief 开始读，返回的序号用于ReadRetry
+           * @note 有写者正在写时会等待
+           */
+          uint32_t ReadBegin()
+          {
+              unsigned int try_times = 0;
+              uint32_t ret;
+              while ((ret = m_uSequence.load(::std::memory_order_acquire)) & 0x01)
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
+
+              return ret;
+          }
+
+          /**
+           * @brief 读结束，返回true表示期间有写入，需要重新读
+           */
+          bool ReadRetry(uint32_t seq)
+          {
+              ::std::atomic_thread_fence(::std::memory_order_acquire);
+              return m_uSequence.load(::std::memory_order_relaxed) != seq;
+          }
+
+          // ============ 写者 ============
+          void Lock()
+          {
+              unsigned int try_times = 0;
+              while (!TryLock())
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
+          }
+
+          void Unlock()
+          {
+              m_uSequence.store(m_uSequence.load(::std::memory_order_relaxed) + 1, ::std::memory_order_release);
+          }
+
+          bool TryLock()
+          {
+              uint32_t seq = m_uSequence.load(::std::memory_order_relaxed);
+              if (seq & 0x01)
+                  return false;
+
+              // acquire保证和上一个写者的Unlock同步，原地修改数据时能看到上一个写者写入的内容
+              if (!m_uSequence.compare_exchange_strong(seq, seq + 1, ::std::memory_order_acquire, ::std::memory_order_relaxed))
+                  return false;
+
+              // 序号变为奇数必须在写数据之前对读者可见
+              ::std::atomic_thread_fence(::std::memory_order_release);
+              return true;
+          }
+
+          bool TryUnlock()
+          {
+              if (!IsLocked())
+                  return false;
+
+              Unlock();
+              return true;
+          }
+
+          bool IsLocked()
+          {
+              return 0 != (m_uSequence.load(::std::memory_order_acquire) & 0x01);
+          }
+        };
+
+        /**
+         * @brief 用顺序锁保护的POD数据
+         * @note T必须可以用memcpy复制
+         */
+        template<typename T>
+        class SeqLockValue
+        {
+        public:
+          typedef T value_type;
+
+          SeqLockValue() { memset(&m_stData, 0, sizeof(m_stData)); }
+          explicit SeqLockValue(const T& v) { memcpy(&m_stData, &v, sizeof(m_stData)); }
+
+          /**
+           * @brief 读取一致的快照
+           */
+          T Load()
+          {
+              T ret;
+              uint32_t seq;
+              do
+              {
+                  seq = m_stLock.ReadBegin();
+                  memcpy(&ret, const_cast<const T*>(&m_stData), sizeof(ret));
+              } while (m_stLock.ReadRetry(seq));
+
+              return ret;
+          }
+
+          void Store(const T& v)
+          {
+              m_stLock.Lock();
+              memcpy(&m_stData, &v, sizeof(m_stData));
+              m_stLock.Unlock();
+          }
+
+          /**
+           * @brief 获取锁，用于原地修改数据
+           */
+          SeqLock& GetLock() { return m_stLock; }
+          T* GetRawData() { return &m_stData; }
+
+        private:
+          SeqLock m_stLock;
+          T m_stData;
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_SEQLOCK_H_ */
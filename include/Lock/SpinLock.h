@@ -19,6 +19,8 @@
  *         4. add gcc atomic support
  *    2014-07-08
  *         1. add yield operation 
+ *    2016-06-04
+ *         1. fix wait counter wrap around (it fell back to busy-wait after sleeping)
  */
 
 #ifndef _UTIL_LOCK_SPINLOCK_H_
@@ -132,11 +134,12 @@
  *   3. thread give up cpu time slice but will not switch to another process
  *   4. thread give up cpu time slice (may switch to another process)
  *   5. sleep (will switch to another process when necessary)
+ *   调用者的计数需要饱和（不能回绕），否则sleep之后又会回到busy-wait
  */
  
 #define __UTIL_LOCK_SPIN_LOCK_WAIT(x) \
     { \
-        unsigned char try_lock_times = static_cast<unsigned char>(x); \
+        unsigned int try_lock_times = static_cast<unsigned int>(x); \
         if (try_lock_times < 4) {} \
         else if (try_lock_times < 16) { __UTIL_LOCK_SPIN_LOCK_PAUSE(); } \
         else if (try_lock_times < 32) { __UTIL_LOCK_SPIN_LOCK_THREAD_YIELD(); } \
@@ -165,9 +168,9 @@ namespace util
 
           void Lock()
           {
-              unsigned char try_times = 0;
+              unsigned int try_times = 0;
               while (m_enStatus.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_acq_rel) == Locked)
-                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times ++); /* busy-wait */
+                  __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
           }
 
           void Unlock()
@@ -235,16 +238,16 @@ namespace util
 
           void Lock()
           {
-                unsigned char try_times = 0;
+                unsigned int try_times = 0;
             #ifdef __UTIL_LOCK_SPINLOCK_ATOMIC_MSVC
                 while(InterlockedExchange(&m_enStatus, Locked) == Locked)
-                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times ++); /* busy-wait */
+                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
             #elif defined(__UTIL_LOCK_SPINLOCK_ATOMIC_GCC_ATOMIC)
                 while (__atomic_exchange_n(&m_enStatus, Locked, __ATOMIC_ACQ_REL) == Locked)
-                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times ++); /* busy-wait */
+                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
             #else
                 while(__sync_lock_test_and_set(&m_enStatus, Locked) == Locked)
-                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times ++); /* busy-wait */
+                    __UTIL_LOCK_SPIN_LOCK_WAIT(try_times < 64 ? try_times ++ : try_times); /* busy-wait */
             #endif
           }
 
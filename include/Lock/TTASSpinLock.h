@@ -0,0 +1,241 @@
+﻿/**
+ * @file TTASSpinLock.h
+ * @brief test-and-test-and-set 自旋锁
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-04
+ *
+ * @note 等待时只读取锁状态（共享缓存行），看到锁空闲才做exchange
+ * @note 退避按指数增长并带随机抖动，避免所有等待者同时醒来抢锁；阈值可以按实例调整
+ * @note 可选记录竞争统计（每次加锁的pause、yield和sleep次数），用于调整工作线程池
+ * @note 接口和SpinLock一致，可以直接用于LockHolder
+ * @note 使用了 c++11的atomic
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_TTASSPINLOCK_H_
+#define _UTIL_LOCK_TTASSPINLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class TTASSpinLock
+        {
+        public:
+          /**
+           * @brief 退避参数
+           * @note 每轮等待pause的次数从min_pause开始翻倍到max_pause，
+           *       等待了yield_after轮后改为让出时间片，等待了sleep_after轮后改为sleep
+           */
+          struct BackoffOption
+          {
+              uint32_t min_pause;
+              uint32_t max_pause;
+              uint32_t yield_after;
+              uint32_t sleep_after;
+          };
+
+          /**
+           * @brief 竞争统计
+           */
+          struct Stat
+          {
+              uint64_t acquire_count;     // 加锁次数
+              uint64_t contended_count;   // 第一次尝试失败的加锁次数
+              uint64_t pause_count;       // pause总次数
+              uint64_t yield_count;       // 让出时间片总次数
+              uint64_t sleep_count;       // sleep总次数
+          };
+
+        private:
+          typedef enum {Unlocked = 0, Locked = 1} LockState;
+          ::std::atomic_uint m_enStatus;
+          BackoffOption m_stOption;
+          bool m_bEnableStat;
+
+          // 统计放在单独的缓存行，不影响锁状态的读取
+          char m_szPadding[64];
+          ::std::atomic<uint64_t> m_ullAcquire;
+          ::std::atomic<uint64_t> m_ullContended;
+          ::std::atomic<uint64_t> m_ullPause;
+          ::std::atomic<uint64_t> m_ullYield;
+          ::std::atomic<uint64_t> m_ullSleep;
+
+          TTASSpinLock(const TTASSpinLock&);
+          TTASSpinLock& operator=(const TTASSpinLock&);
+
+        public:
+          TTASSpinLock() : m_bEnableStat(false) {
+              m_enStatus.store(Unlocked);
+              m_stOption = DefaultBackoffOption();
+              ResetStat();
+          }
+
+          static BackoffOption DefaultBackoffOption()
+          {
+              BackoffOption ret;
+              ret.min_pause = 4;
+              ret.max_pause = 1024;
+              ret.yield_after = 16;
+              ret.sleep_after = 64;
+              return ret;
+          }
+
+          /**
+           * @brief 设置退避参数，需要在没有竞争时调用
+           */
+          void SetBackoffOption(const BackoffOption& opt)
+          {
+              m_stOption = opt;
+              if (0 == m_stOption.min_pause)
+                  m_stOption.min_pause = 1;
+              if (m_stOption.max_pause < m_stOption.min_pause)
+                  m_stOption.max_pause = m_stOption.min_pause;
+              if (m_stOption.sleep_after < m_stOption.yield_after)
+                  m_stOption.sleep_after = m_stOption.yield_after;
+          }
+
+          const BackoffOption& GetBackoffOption() const { return m_stOption; }
+
+          /**
+           * @brief 开启或关闭竞争统计，默认关闭
+           */
+          void SetEnableStat(bool v) { m_bEnableStat = v; }
+          bool GetEnableStat() const { return m_bEnableStat; }
+
+          Stat GetStat() const
+          {
+              Stat ret;
+              ret.acquire_count = m_ullAcquire.load(::std::memory_order_relaxed);
+              ret.contended_count = m_ullContended.load(::std::memory_order_relaxed);
+              ret.pause_count = m_ullPause.load(::std::memory_order_relaxed);
+              ret.yield_count = m_ullYield.load(::std::memory_order_relaxed);
+              ret.sleep_count = m_ullSleep.load(::std::memory_order_relaxed);
+              return ret;
+          }
+
+          void ResetStat()
+          {
+              m_ullAcquire.store(0, ::std::memory_order_relaxed);
+              m_ullContended.store(0, ::std::memory_order_relaxed);
+              m_ullPause.store(0, ::std::memory_order_relaxed);
+              m_ullYield.store(0, ::std::memory_order_relaxed);
+              m_ullSleep.store(0, ::std::memory_order_relaxed);
+          }
+
+          void Lock()
+          {
+              // 快速路径，先读再exchange，锁被占用时不写缓存行
+              if (m_enStatus.load(::std::memory_order_relaxed) == Unlocked &&
+                  m_enStatus.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_acquire) == Unlocked)
+              {
+                  if (m_bEnableStat)
+                      m_ullAcquire.fetch_add(1, ::std::memory_order_relaxed);
+                  return;
+              }
+
+              LockSlow();
+          }
+
+          void Unlock()
+          {
+              m_enStatus.store(static_cast<unsigned int>(Unlocked), ::std::memory_order_release);
+          }
+
+          bool IsLocked()
+          {
+              return m_enStatus.load(::std::memory_order_acquire) == Locked;
+          }
+
+          bool TryLock()
+          {
+              if (m_enStatus.load(::std::memory_order_relaxed) == Locked)
+                  return false;
+
+              bool ret = m_enStatus.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_acquire) == Unlocked;
+              if (ret && m_bEnableStat)
+                  m_ullAcquire.fetch_add(1, ::std::memory_order_relaxed);
+              return ret;
+          }
+
+          bool TryUnlock()
+          {
+              return m_enStatus.exchange(static_cast<unsigned int>(Unlocked), ::std::memory_order_acq_rel) == Locked;
+          }
+
+        private:
+          void LockSlow()
+          {
+              uint32_t round = 0;
+              uint32_t pause_limit = m_stOption.min_pause;
+              uint64_t pause_count = 0, yield_count = 0, sleep_count = 0;
+              // 每个线程的栈地址不同，用作抖动的随机种子
+              uint32_t seed = static_cast<uint32_t>(reinterpret_cast<size_t>(&round) >> 4) | 1;
+
+              while (true)
+              {
+                  // 只读等待，锁空闲后再尝试exchange
+                  while (m_enStatus.load(::std::memory_order_relaxed) == Locked)
+                  {
+                      if (round < m_stOption.yield_after)
+                      {
+                          // xorshift32，在[pause_limit/2, pause_limit]之间抖动
+                          seed ^= seed << 13;
+                          seed ^= seed >> 17;
+                          seed ^= seed << 5;
+                          uint32_t times = pause_limit - seed % (pause_limit / 2 + 1);
+                          for (uint32_t i = 0; i < times; ++i)
+                              __UTIL_LOCK_SPIN_LOCK_PAUSE();
+                          pause_count += times;
+
+                          if (pause_limit < m_stOption.max_pause)
+                              pause_limit = (pause_limit * 2 > m_stOption.max_pause) ? m_stOption.max_pause : pause_limit * 2;
+                      }
+                      else if (round < m_stOption.sleep_after)
+                      {
+                          __UTIL_LOCK_SPIN_LOCK_THREAD_YIELD();
+                          ++yield_count;
+                      }
+                      else
+                      {
+                          __UTIL_LOCK_SPIN_LOCK_THREAD_SLEEP();
+                          ++sleep_count;
+                      }
+
+                      // 饱和计数，不会回绕到busy-wait
+                      if (round < m_stOption.sleep_after)
+                          ++round;
+                  }
+
+                  if (m_enStatus.exchange(static_cast<unsigned int>(Locked), ::std::memory_order_acquire) == Unlocked)
+                      break;
+              }
+
+              if (m_bEnableStat)
+              {
+                  m_ullAcquire.fetch_add(1, ::std::memory_order_relaxed);
+                  m_ullContended.fetch_add(1, ::std::memory_order_relaxed);
+                  m_ullPause.fetch_add(pause_count, ::std::memory_order_relaxed);
+                  m_ullYield.fetch_add(yield_count, ::std::memory_order_relaxed);
+                  m_ullSleep.fetch_add(sleep_count, ::std::memory_order_relaxed);
+              }
+          }
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_TTASSPINLOCK_H_ */
@@ -0,0 +1,103 @@
+﻿/**
+ * @file TicketLock.h
+ * @brief 排队自旋锁
+ * Licensed under the MIT licenses.
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-04
+ *
+ * @note 按取号顺序获得锁（FIFO），等待者只读取now_serving，不会反复对同一缓存行做exchange
+ * @note 接口和SpinLock一致，可以直接用于LockHolder
+ * @note 使用了 c++11的atomic
+ *
+ * @history
+ */
+
+#ifndef _UTIL_LOCK_TICKETLOCK_H_
+#define _UTIL_LOCK_TICKETLOCK_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif
+
+#include <atomic>
+
+#include "SpinLock.h"
+
+namespace util
+{
+    namespace lock
+    {
+        class TicketLock
+        {
+        private:
+          // 取号和叫号分别放在不同的缓存行
+          ::std::atomic_uint m_uNextTicket;
+          char m_szPadding[64 - sizeof(::std::atomic_uint)];
+          ::std::atomic_uint m_uNowServing;
+
+          TicketLock(const TicketLock&);
+          TicketLock& operator=(const TicketLock&);
+
+        public:
+          TicketLock() {
+              m_uNextTicket.store(0);
+              m_uNowServing.store(0);
+          }
+
+          void Lock()
+          {
+              unsigned int my_ticket = m_uNextTicket.fetch_add(1, ::std::memory_order_relaxed);
+              unsigned int try_times = 0;
+              while (true)
+              {
+                  unsigned int now_serving = m_uNowServing.load(::std::memory_order_acquire);
+                  if (now_serving == my_ticket)
+                      return;
+
+                  // 按前面排队的人数退避，排得越靠后等得越久
+                  if (try_times < 64)
+                  {
+                      ++try_times;
+                      for (unsigned int i = my_ticket - now_serving; i > 0; --i)
+                          __UTIL_LOCK_SPIN_LOCK_PAUSE();
+                  }
+                  else
+                  {
+                      __UTIL_LOCK_SPIN_LOCK_THREAD_YIELD();
+                  }
+              }
+          }
+
+          void Unlock()
+          {
+              // 只有持有者会修改now_serving
+              m_uNowServing.store(m_uNowServing.load(::std::memory_order_relaxed) + 1, ::std::memory_order_release);
+          }
+
+          bool IsLocked()
+          {
+              return m_uNextTicket.load(::std::memory_order_acquire) != m_uNowServing.load(::std::memory_order_acquire);
+          }
+
+          bool TryLock()
+          {
+              unsigned int now_serving = m_uNowServing.load(::std::memory_order_acquire);
+              unsigned int expected = now_serving;
+              return m_uNextTicket.compare_exchange_strong(expected, now_serving + 1, ::std::memory_order_acquire, ::std::memory_order_relaxed);
+          }
+
+          bool TryUnlock()
+          {
+              if (!IsLocked())
+                  return false;
+
+              Unlock();
+              return true;
+          }
+        };
+    }
+}
+
+#endif /* _UTIL_LOCK_TICKETLOCK_H_ */
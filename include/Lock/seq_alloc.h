@@ -17,6 +17,8 @@
  *
  * @history
  *     2015-12-14   created
+ *     2016-06-05   增加缓存行填充的padded_seq_alloc和按线程分片的sharded_seq_alloc
+ *     2016-06-05   所有操作增加显式指定memory_order的重载，纯计数和序号分配可以使用memory_order_relaxed
  */
 
 #ifndef _UTIL_LOCK_SEQ_ALLOC_H_
@@ -26,6 +28,9 @@
 # pragma once
 #endif
 #include <stdint.h>
+#include <cstddef>
+
+#include "std/thread.h"
 
 #if defined(__cplusplus) && defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 1 ) ) && __cplusplus >= 201103L
 #include <atomic>
@@ -45,6 +50,47 @@
 
 namespace util {
     namespace lock {
+        /**
+         * @brief 内存序，用于seq_alloc的显式内存序重载
+         * @note C++11下就是std::memory_order；低版本gcc映射到__ATOMIC_*；__sync_*和VC的Interlocked*总是全屏障，会忽略这个参数
+         */
+#if defined(__UTIL_LOCK_SEQ_ALLOC_ATOMIC_STD)
+        typedef ::std::memory_order memory_order;
+        using ::std::memory_order_relaxed;
+        using ::std::memory_order_consume;
+        using ::std::memory_order_acquire;
+        using ::std::memory_order_release;
+        using ::std::memory_order_acq_rel;
+        using ::std::memory_order_seq_cst;
+#else
+        // 和__ATOMIC_*的取值一致
+        typedef enum {
+            memory_order_relaxed = 0,
+            memory_order_consume,
+            memory_order_acquire,
+            memory_order_release,
+            memory_order_acq_rel,
+            memory_order_seq_cst
+        } memory_order;
+#endif
+
+        namespace detail {
+            /**
+             * @brief compare_exchange失败时的内存序不能包含release
+             */
+            inline memory_order seq_alloc_failure_order(memory_order order) {
+                if (memory_order_acq_rel == order) {
+                    return memory_order_acquire;
+                }
+
+                if (memory_order_release == order) {
+                    return memory_order_relaxed;
+                }
+
+                return order;
+            }
+        }
+
         // C++ 0x/11版实现
 #if defined(__UTIL_LOCK_SEQ_ALLOC_ATOMIC_STD)
 #define __UTIL_LOCK_SEQ_ALLOC_ATOMIC_BRANCH_NAME "std::atomic<T>"
@@ -102,6 +148,47 @@ namespace util {
             value_type dec() {
                 return sub(static_cast<value_type>(1)) - static_cast<value_type>(1);
             }
+
+            // 显式指定内存序
+            value_type get(memory_order order) const {
+                return data_.load(order);
+            }
+
+            value_type set(value_type val, memory_order order) {
+                return data_.exchange(val, order);
+            }
+
+            value_type add(value_type val, memory_order order) {
+                return data_.fetch_add(val, order);
+            }
+
+            value_type sub(value_type val, memory_order order) {
+                return data_.fetch_sub(val, order);
+            }
+
+            value_type band(value_type val, memory_order order) {
+                return data_.fetch_and(val, order);
+            }
+
+            value_type bor(value_type val, memory_order order) {
+                return data_.fetch_or(val, order);
+            }
+
+            value_type bxor(value_type val, memory_order order) {
+                return data_.fetch_xor(val, order);
+            }
+
+            bool compare_exchange(value_type expected, value_type val, memory_order order) {
+                return data_.compare_exchange_strong(expected, val, order, detail::seq_alloc_failure_order(order));
+            }
+
+            value_type inc(memory_order order) {
+                return add(static_cast<value_type>(1), order) + static_cast<value_type>(1);
+            }
+
+            value_type dec(memory_order order) {
+                return sub(static_cast<value_type>(1), order) - static_cast<value_type>(1);
+            }
         };
 
         typedef seq_alloc<uint8_t> seq_alloc_u8;
@@ -382,6 +469,58 @@ namespace util {
                 return sub(static_cast<value_type>(1)) - static_cast<value_type>(1);
 #endif
             }
+
+            // 显式指定内存序，只有__atomic_*分支会使用，其他分支总是全屏障
+#if defined(__UTIL_LOCK_SEQ_ALLOC_ATOMIC_GCC_ATOMIC)
+            value_type get(memory_order order) {
+                return __atomic_load_n(&data_, static_cast<int>(order));
+            }
+
+            value_type set(value_type val, memory_order order) {
+                return __atomic_exchange_n(&data_, val, static_cast<int>(order));
+            }
+
+            value_type add(value_type val, memory_order order) {
+                return __atomic_fetch_add(&data_, val, static_cast<int>(order));
+            }
+
+            value_type sub(value_type val, memory_order order) {
+                return __atomic_fetch_sub(&data_, val, static_cast<int>(order));
+            }
+
+            value_type band(value_type val, memory_order order) {
+                return __atomic_fetch_and(&data_, val, static_cast<int>(order));
+            }
+
+            value_type bor(value_type val, memory_order order) {
+                return __atomic_fetch_or(&data_, val, static_cast<int>(order));
+            }
+
+            value_type bxor(value_type val, memory_order order) {
+                return __atomic_fetch_xor(&data_, val, static_cast<int>(order));
+            }
+
+            bool compare_exchange(value_type expected, value_type val, memory_order order) {
+                return __atomic_compare_exchange_n(&data_, &expected, val, false, static_cast<int>(order), static_cast<int>(detail::seq_alloc_failure_order(order)));
+            }
+#else
+            value_type get(memory_order) { return get(); }
+            value_type set(value_type val, memory_order) { return set(val); }
+            value_type add(value_type val, memory_order) { return add(val); }
+            value_type sub(value_type val, memory_order) { return sub(val); }
+            value_type band(value_type val, memory_order) { return band(val); }
+            value_type bor(value_type val, memory_order) { return bor(val); }
+            value_type bxor(value_type val, memory_order) { return bxor(val); }
+            bool compare_exchange(value_type expected, value_type val, memory_order) { return compare_exchange(expected, val); }
+#endif
+
+            value_type inc(memory_order order) {
+                return add(static_cast<value_type>(1), order) + static_cast<value_type>(1);
+            }
+
+            value_type dec(memory_order order) {
+                return sub(static_cast<value_type>(1), order) - static_cast<value_type>(1);
+            }
         };
 
 
@@ -394,6 +533,129 @@ namespace util {
         typedef seq_alloc<int32_t> seq_alloc_i32;
         typedef seq_alloc<int64_t> seq_alloc_i64;
 #endif
+
+        namespace detail {
+            template<size_t SIZE>
+            struct seq_alloc_padding {
+                char padding_head_[SIZE];
+            };
+        }
+
+        /**
+         * @brief 独占缓存行的seq_alloc，前后都有填充，避免和相邻变量伪共享
+         * @note 可以当作seq_alloc<Ty>使用
+         */
+        template<typename Ty, size_t CACHE_LINE_SIZE = 64>
+        class padded_seq_alloc : private detail::seq_alloc_padding<CACHE_LINE_SIZE>, public seq_alloc<Ty> {
+        public:
+            typedef Ty value_type;
+            typedef seq_alloc<Ty> base_type;
+
+        private:
+            char padding_tail_[CACHE_LINE_SIZE > sizeof(base_type) ? CACHE_LINE_SIZE - sizeof(base_type) : 1];
+        };
+
+        typedef padded_seq_alloc<uint32_t> padded_seq_alloc_u32;
+        typedef padded_seq_alloc<uint64_t> padded_seq_alloc_u64;
+        typedef padded_seq_alloc<int32_t> padded_seq_alloc_i32;
+        typedef padded_seq_alloc<int64_t> padded_seq_alloc_i64;
+
+        /**
+         * @brief 分配线程的分片下标，每个线程第一次调用时分配，之后保持不变
+         */
+        inline size_t seq_alloc_thread_shard_index() {
+            static seq_alloc<uint32_t> shard_alloc;
+            static THREAD_TLS uint32_t shard_index = 0;
+            if (0 == shard_index) {
+                while (0 == (shard_index = shard_alloc.inc()));
+            }
+
+            return static_cast<size_t>(shard_index - 1);
+        }
+
+        /**
+         * @brief 按线程分片的计数器，写入只修改当前线程的分片，读取时求和
+         * @note 适合多线程频繁写、偶尔读的统计计数
+         * @note add/sub/inc/dec不返回计数值（返回整体值需要读所有分片），需要时调用get
+         * @note get不是原子快照，set只在没有并发写入时有意义
+         */
+        template<typename Ty, size_t SHARD_NUM = 16>
+        class sharded_seq_alloc {
+        public:
+            typedef Ty value_type;
+
+            value_type get() const {
+                value_type ret = static_cast<value_type>(0);
+                for (size_t i = 0; i < SHARD_NUM; ++i) {
+                    ret += const_cast<padded_seq_alloc<Ty>&>(shards_[i]).get(memory_order_relaxed);
+                }
+
+                return ret;
+            }
+
+            void set(value_type val) {
+                shards_[0].set(val);
+                for (size_t i = 1; i < SHARD_NUM; ++i) {
+                    shards_[i].set(static_cast<value_type>(0));
+                }
+            }
+
+            // 纯计数，不用于同步其他数据，所以使用relaxed
+            void add(value_type val) {
+                local().add(val, memory_order_relaxed);
+            }
+
+            void sub(value_type val) {
+                local().sub(val, memory_order_relaxed);
+            }
+
+            void inc() {
+                local().add(static_cast<value_type>(1), memory_order_relaxed);
+            }
+
+            void dec() {
+                local().sub(static_cast<value_type>(1), memory_order_relaxed);
+            }
+
+            /**
+             * @brief 显式指定内存序，用于需要同步的场景
+             * @note 每个分片分别按order读取，所有写入都按seq_cst时，先于读取的写入一定能被读到
+             */
+            value_type get(memory_order order) const {
+                value_type ret = static_cast<value_type>(0);
+                for (size_t i = 0; i < SHARD_NUM; ++i) {
+                    ret += const_cast<padded_seq_alloc<Ty>&>(shards_[i]).get(order);
+                }
+
+                return ret;
+            }
+
+            void add(value_type val, memory_order order) {
+                local().add(val, order);
+            }
+
+            void sub(value_type val, memory_order order) {
+                local().sub(val, order);
+            }
+
+            void inc(memory_order order) {
+                local().add(static_cast<value_type>(1), order);
+            }
+
+            void dec(memory_order order) {
+                local().sub(static_cast<value_type>(1), order);
+            }
+
+        private:
+            inline padded_seq_alloc<Ty>& local() {
+                return shards_[seq_alloc_thread_shard_index() % SHARD_NUM];
+            }
+
+            padded_seq_alloc<Ty> shards_[SHARD_NUM];
+        };
+
+        typedef sharded_seq_alloc<uint64_t> sharded_seq_alloc_u64;
+        typedef sharded_seq_alloc<int64_t> sharded_seq_alloc_i64;
     }
 }
 
@@ -0,0 +1,354 @@
+/**
+ * @file concurrent_lru_pool.h
+ * @brief 线程安全的lru对象池<br />
+ * Licensed under the MIT licenses.
+ *
+ * @note 按key的hash分片，每个分片是一个独立加锁的lru_pool和lru_pool_manager
+ * @note 分片前有按线程分配的magazine缓存，线程在自己的magazine命中时只需要一次无竞争的加锁
+ * @note magazine中的对象不计入分片lru_pool_manager的数量和字节统计，也不会被它回收，直到下一次proc/gc/flush_magazines放回分片
+ * @note 分片拒绝的对象会留在magazine里；push的对象放不进magazine且被分片拒绝时返回false，对象仍归调用者所有
+ *
+ * @version 1.0
+ * @author owent
+ * @date 2016-06-02
+ *
+ * @history
+ *
+ */
+
+#ifndef _UTIL_MEMPOOL_CONCURRENTLRUPOOL_H_
+#define _UTIL_MEMPOOL_CONCURRENTLRUPOOL_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+#include "std/smart_ptr.h"
+#include "std/thread.h"
+
+#include "Lock/seq_alloc.h"
+#include "Lock/SpinLock.h"
+#include "Lock/LockHolder.h"
+
+#include "lru_object_pool.h"
+
+namespace util {
+    namespace mempool {
+        namespace detail {
+            /**
+            * @brief 分片内部使用的action，push/pull/reset由concurrent_lru_pool在对外接口处调用，这里只转发gc和size
+            */
+            template<typename TObj, typename TAction>
+            struct concurrent_lru_shard_action {
+                void push(TObj*) {}
+                void pull(TObj*) {}
+                void reset(TObj*) {}
+                void gc(TObj* obj) {
+                    TAction act;
+                    act.gc(obj);
+                }
+
+                size_t size(TObj* obj) {
+                    TAction act;
+                    return lru_action_size<TAction, TObj>::size(act, obj);
+                }
+            };
+
+            /**
+            * @brief 分配线程的magazine槽位，每个线程第一次调用时分配，之后保持不变
+            */
+            inline size_t concurrent_lru_thread_slot() {
+                return util::lock::seq_alloc_thread_shard_index();
+            }
+        }
+
+        template<typename TKey, typename TObj, typename TAction = lru_default_action<TObj>,
+            typename TStorage = lru_slab_list_storage<>, typename THash = std::hash<TKey> >
+        class concurrent_lru_pool {
+        public:
+            typedef TKey key_t;
+            typedef TObj value_type;
+            typedef TAction action_type;
+            typedef TStorage storage_type;
+            typedef THash hash_type;
+            typedef lru_pool<TKey, TObj, detail::concurrent_lru_shard_action<TObj, TAction>, TStorage> shard_pool_type;
+
+            struct shard_t {
+                util::lock::SpinLock lock;
+                lru_pool_manager::ptr_t mgr;
+                shard_pool_type pool;
+                // 避免相邻分片的锁伪共享
+                char padding[64];
+            };
+
+            struct magazine_item_t {
+                key_t key;
+                value_type* object;
+            };
+
+            struct magazine_t {
+                util::lock::SpinLock lock;
+                size_t size;
+                std::vector<magazine_item_t> items;
+                char padding[64];
+            };
+
+            typedef std::shared_ptr<shard_t> shard_ptr_type;
+            typedef std::shared_ptr<magazine_t> magazine_ptr_type;
+
+        private:
+            concurrent_lru_pool(const concurrent_lru_pool&);
+            concurrent_lru_pool& operator=(const concurrent_lru_pool&);
+
+        public:
+            concurrent_lru_pool() : shard_mask_(0) {}
+
+            ~concurrent_lru_pool() {
+                clear();
+            }
+
+            /**
+            * @brief 初始化，必须在多线程使用前调用
+            * @param shard_num 分片数量，会向上取整到2的幂
+            * @param magazine_num magazine数量，建议不小于工作线程数
+            * @param magazine_size 每个magazine缓存的对象上限
+            * @return 0或错误码
+            */
+            int init(size_t shard_num = 16, size_t magazine_num = 16, size_t magazine_size = 32) {
+                if (0 == shard_num || 0 == magazine_num || magazine_size < 2) {
+                    return -1;
+                }
+
+                clear();
+
+                size_t real_shard_num = 1;
+                while (real_shard_num < shard_num) {
+                    real_shard_num <<= 1;
+                }
+
+                shards_.clear();
+                shards_.reserve(real_shard_num);
+                for (size_t i = 0; i < real_shard_num; ++i) {
+                    shard_ptr_type s = std::make_shared<shard_t>();
+                    s->mgr = lru_pool_manager::create();
+                    s->pool.init(s->mgr);
+                    shards_.push_back(s);
+                }
+                shard_mask_ = real_shard_num - 1;
+
+                magazines_.clear();
+                magazines_.reserve(magazine_num);
+                for (size_t i = 0; i < magazine_num; ++i) {
+                    magazine_ptr_type m = std::make_shared<magazine_t>();
+                    m->size = 0;
+                    m->items.resize(magazine_size);
+                    magazines_.push_back(m);
+                }
+
+                return 0;
+            }
+
+            bool push(key_t id, TObj* obj) {
+                if (NULL == obj || shards_.empty()) {
+                    return false;
+                }
+
+                // act.push只在对象被接收之后调用，被拒绝的对象仍由调用者处理
+                TAction act;
+                magazine_t& mag = get_magazine();
+                if (mag.lock.TryLock()) {
+                    // 满了则把较旧的一半放回分片，分片拒绝的留在magazine里
+                    if (mag.size >= mag.items.size()) {
+                        spill_magazine(mag, mag.items.size() / 2);
+                    }
+
+                    if (mag.size < mag.items.size()) {
+                        mag.items[mag.size].key = id;
+                        mag.items[mag.size].object = obj;
+                        ++mag.size;
+                        mag.lock.Unlock();
+                        act.push(obj);
+                        return true;
+                    }
+                    mag.lock.Unlock();
+                }
+
+                if (!push_shard(id, obj)) {
+                    return false;
+                }
+
+                act.push(obj);
+                return true;
+            }
+
+            TObj* pull(key_t id) {
+                if (shards_.empty()) {
+                    return NULL;
+                }
+
+                TObj* ret = NULL;
+                magazine_t& mag = get_magazine();
+                if (mag.lock.TryLock()) {
+                    // FILO, 从最新放入的开始找
+                    for (size_t i = mag.size; i > 0; --i) {
+                        if (mag.items[i - 1].key == id) {
+                            ret = mag.items[i - 1].object;
+                            for (size_t j = i; j < mag.size; ++j) {
+                                mag.items[j - 1] = mag.items[j];
+                            }
+                            --mag.size;
+                            break;
+                        }
+                    }
+                    mag.lock.Unlock();
+                }
+
+                if (NULL == ret) {
+                    shard_t& s = get_shard(id);
+                    util::lock::LockHolder<util::lock::SpinLock> holder(s.lock);
+                    ret = s.pool.pull(id);
+                }
+
+                if (NULL != ret) {
+                    TAction act;
+                    act.pull(ret);
+                    act.reset(ret);
+                }
+
+                return ret;
+            }
+
+            /**
+            * @brief 定时回调，把magazine中的对象放回分片并执行每个分片管理器的proc
+            * @param tick 用于判定超时的tick时间，时间单位由业务逻辑决定
+            * @return 此次调用回收的元素的个数
+            */
+            size_t proc(time_t tick) {
+                flush_magazines();
+
+                size_t ret = 0;
+                for (size_t i = 0; i < shards_.size(); ++i) {
+                    util::lock::LockHolder<util::lock::SpinLock> holder(shards_[i]->lock);
+                    ret += shards_[i]->mgr->proc(tick);
+                }
+
+                return ret;
+            }
+
+            /**
+            * @brief 主动GC，会触发每个分片的阈值自适应
+            * @return 此次调用回收的元素的个数
+            */
+            size_t gc() {
+                flush_magazines();
+
+                size_t ret = 0;
+                for (size_t i = 0; i < shards_.size(); ++i) {
+                    util::lock::LockHolder<util::lock::SpinLock> holder(shards_[i]->lock);
+                    ret += shards_[i]->mgr->gc();
+                }
+
+                return ret;
+            }
+
+            /**
+            * @brief 把所有magazine中的对象放回分片，分片拒绝的对象留在magazine里
+            */
+            void flush_magazines() {
+                for (size_t i = 0; i < magazines_.size(); ++i) {
+                    magazine_t& mag = *magazines_[i];
+                    util::lock::LockHolder<util::lock::SpinLock> holder(mag.lock);
+                    spill_magazine(mag, mag.size);
+                }
+            }
+
+            /**
+            * @brief 释放所有缓存的对象
+            * @note 不能和push/pull并发调用
+            */
+            void clear() {
+                TAction act;
+                for (size_t i = 0; i < magazines_.size(); ++i) {
+                    magazine_t& mag = *magazines_[i];
+                    util::lock::LockHolder<util::lock::SpinLock> holder(mag.lock);
+                    for (size_t j = 0; j < mag.size; ++j) {
+                        act.gc(mag.items[j].object);
+                    }
+                    mag.size = 0;
+                }
+
+                for (size_t i = 0; i < shards_.size(); ++i) {
+                    util::lock::LockHolder<util::lock::SpinLock> holder(shards_[i]->lock);
+                    shards_[i]->pool.clear();
+                }
+            }
+
+            /**
+            * @brief 缓存的对象总数，并发访问时只是近似值
+            */
+            size_t size() {
+                size_t ret = 0;
+                for (size_t i = 0; i < magazines_.size(); ++i) {
+                    util::lock::LockHolder<util::lock::SpinLock> holder(magazines_[i]->lock);
+                    ret += magazines_[i]->size;
+                }
+
+                for (size_t i = 0; i < shards_.size(); ++i) {
+                    util::lock::LockHolder<util::lock::SpinLock> holder(shards_[i]->lock);
+                    ret += shards_[i]->pool.size();
+                }
+
+                return ret;
+            }
+
+            inline size_t shard_size() const { return shards_.size(); }
+            inline size_t magazine_size() const { return magazines_.size(); }
+
+            /**
+            * @brief 获取分片的管理器，用于设置回收阈值
+            * @note 只能在初始化阶段修改，运行期修改需要自行保证不和proc/gc并发
+            */
+            inline lru_pool_manager::ptr_t get_shard_manager(size_t idx) const {
+                return idx < shards_.size() ? shards_[idx]->mgr : lru_pool_manager::ptr_t();
+            }
+
+        private:
+            inline shard_t& get_shard(const key_t& id) {
+                size_t h = static_cast<size_t>(hash_type()(id));
+                h ^= (h >> 16);
+                return *shards_[h & shard_mask_];
+            }
+
+            inline magazine_t& get_magazine() {
+                return *magazines_[detail::concurrent_lru_thread_slot() % magazines_.size()];
+            }
+
+            // 把magazine中最旧的count个对象放回分片，分片拒绝的按原顺序保留，调用者需要持有magazine的锁
+            void spill_magazine(magazine_t& mag, size_t count) {
+                size_t left = 0;
+                for (size_t i = 0; i < mag.size; ++i) {
+                    if (i < count && push_shard(mag.items[i].key, mag.items[i].object)) {
+                        continue;
+                    }
+
+                    mag.items[left++] = mag.items[i];
+                }
+                mag.size = left;
+            }
+
+            bool push_shard(const key_t& id, TObj* obj) {
+                shard_t& s = get_shard(id);
+                util::lock::LockHolder<util::lock::SpinLock> holder(s.lock);
+                return s.pool.push(id, obj);
+            }
+
+        private:
+            std::vector<shard_ptr_type> shards_;
+            size_t shard_mask_;
+            std::vector<magazine_ptr_type> magazines_;
+        };
+    }
+}
+
+#endif /* _UTIL_MEMPOOL_CONCURRENTLRUPOOL_H_ */
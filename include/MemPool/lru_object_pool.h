@@ -1,4 +1,4 @@
-/**
+﻿/**
  * @file lru_object_pool.h
  * @brief lru 算法的对象池<br />
  * Licensed under the MIT licenses.
@@ -17,6 +17,18 @@
  *                 empty定义改为const
  *                 尽早析构空list
  *
+ *     2016-06-01: 增加节点存储策略模板参数，lru_slab_list_storage模式下节点内存按块分配并复用，push/pull不再申请内存
+ *                 检查列表改为可扩容的环形队列，list引用由weak_ptr改为带版本号的句柄
+ *                 增加按字节数限制缓存的模式，TAction可选提供size(TObj*)接口
+ *                 增加可选的统计数据（命中率、按原因分类的回收数量和自适应阈值），可在其他线程无锁读取快照
+ *                 lru_pool的size和empty改为O(1)，增加按key查询数量的接口
+ *                 重复push检测改用开放寻址的指针哈希表，复杂度恢复为O(1)且不再为每个元素申请内存
+ *                 增加基于单调时钟和分层时间轮的TTL回收模式，每个list只挂一个定时器，按精确的过期时间分批回收
+ *                 增加批量接口pull_n和push_n，一批对象只查找一次并且只占用一个检查列表项
+ *                 增加可选的后台回收器（lru_reclaimer.h），回收的对象交给回收线程执行TAction::gc
+ *                 管理器的元素数、检查列表长度和字节数计数器改为独占缓存行，避免伪共享
+ *                 push序号分配和管理器的计数器、统计数据改用memory_order_relaxed，它们不用于同步其他数据
+ *
  */
 
 #ifndef _UTIL_MEMPOOL_LRUOBJECTPOOL_H_
@@ -25,9 +37,12 @@
 #include <cstddef>
 #include <stdint.h>
 #include <list>
+#include <vector>
 #include <limits>
 #include <ctime>
 #include <algorithm>
+#include <utility>
+#include <chrono>
 
 #include "std/smart_ptr.h"
 
@@ -44,10 +59,7 @@
 #define _UTIL_MEMPOOL_LRUOBJECTPOOL_MAP(...) std::map< __VA_ARGS__ >
 #endif
 
-// 开启这个宏在包含此文件会开启对象重复push进同一个池的检测，同时也会导致push、pull和gc的复杂度由O(1)变为O(log(n))
-#ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
-#include <set>
-#endif
+// 开启这个宏在包含此文件会开启对象重复push进同一个池的检测，使用开放寻址的指针哈希表，push、pull和gc仍是O(1)
 
 namespace util {
     namespace mempool {
@@ -57,6 +69,7 @@ namespace util {
             class list_type_base {
             public:
                 virtual uint64_t tail_id() const = 0;
+                virtual uint64_t tail_push_time() const = 0;
                 virtual size_t size() const = 0;
                 virtual bool gc() = 0;
                 virtual bool empty() const = 0;
@@ -70,6 +83,391 @@ namespace util {
             virtual ~lru_pool_base() {}
         };
 
+        /**
+        * @brief 回收器接口，lru_pool_manager设置了回收器时，被回收的对象交给回收器而不是在当前线程执行TAction::gc
+        * @see lru_reclaimer.h
+        */
+        class lru_reclaimer_base {
+        public:
+            typedef void (*reclaim_fn_t)(void*);
+
+            virtual ~lru_reclaimer_base() {}
+
+            /**
+            * @brief 提交回收任务，可能在多个线程同时调用
+            * @return 失败（队列满或回收器未运行）时返回false，调用者需要自行回收
+            */
+            virtual bool push(reclaim_fn_t fn, void* obj) = 0;
+
+        protected:
+            lru_reclaimer_base() {}
+        };
+
+        namespace detail {
+            /**
+            * @brief 开放寻址（线性探测）的指针集合，容量总是2的幂
+            * @note 删除时使用后移删除，不需要墓碑标记；只在扩容时申请内存
+            */
+            template<typename T>
+            class lru_pointer_set {
+            public:
+                lru_pointer_set() : size_(0) {}
+
+                /**
+                * @brief 插入指针
+                * @return 已存在或指针为NULL时返回false
+                */
+                bool insert(T* p) {
+                    if (NULL == p) {
+                        return false;
+                    }
+
+                    // 负载因子不超过1/2
+                    if ((size_ + 1) * 2 > slots_.size()) {
+                        rehash(slots_.empty() ? 16 : slots_.size() * 2);
+                    }
+
+                    size_t mask = slots_.size() - 1;
+                    for (size_t i = hash(p) & mask;; i = (i + 1) & mask) {
+                        if (NULL == slots_[i]) {
+                            slots_[i] = p;
+                            ++size_;
+                            return true;
+                        }
+
+                        if (p == slots_[i]) {
+                            return false;
+                        }
+                    }
+                }
+
+                /**
+                * @brief 删除指针
+                * @return 不存在时返回false
+                */
+                bool erase(T* p) {
+                    size_t i;
+                    if (!find_slot(p, i)) {
+                        return false;
+                    }
+
+                    // 后移删除，把后续探测链上的元素前移
+                    size_t mask = slots_.size() - 1;
+                    size_t j = i;
+                    while (true) {
+                        j = (j + 1) & mask;
+                        if (NULL == slots_[j]) {
+                            break;
+                        }
+
+                        size_t k = hash(slots_[j]) & mask;
+                        // k 在 (i, j] 区间内的元素不需要移动
+                        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+                            continue;
+                        }
+
+                        slots_[i] = slots_[j];
+                        i = j;
+                    }
+
+                    slots_[i] = NULL;
+                    --size_;
+                    return true;
+                }
+
+                inline bool contains(T* p) const {
+                    size_t i;
+                    return find_slot(p, i);
+                }
+
+                inline size_t size() const { return size_; }
+                inline bool empty() const { return 0 == size_; }
+                inline size_t capacity() const { return slots_.size(); }
+
+                void clear() {
+                    std::fill(slots_.begin(), slots_.end(), static_cast<T*>(NULL));
+                    size_ = 0;
+                }
+
+            private:
+                static inline size_t hash(T* p) {
+                    // 去掉对齐导致的低位0后使用Fibonacci hash
+                    uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p) >> 3) * 0x9E3779B97F4A7C15ULL;
+                    return static_cast<size_t>(h ^ (h >> 32));
+                }
+
+                bool find_slot(T* p, size_t& out) const {
+                    if (NULL == p || slots_.empty()) {
+                        return false;
+                    }
+
+                    size_t mask = slots_.size() - 1;
+                    for (size_t i = hash(p) & mask;; i = (i + 1) & mask) {
+                        if (NULL == slots_[i]) {
+                            return false;
+                        }
+
+                        if (p == slots_[i]) {
+                            out = i;
+                            return true;
+                        }
+                    }
+                }
+
+                void rehash(size_t new_size) {
+                    std::vector<T*> old_slots;
+                    old_slots.swap(slots_);
+                    slots_.resize(new_size, NULL);
+
+                    size_t mask = slots_.size() - 1;
+                    for (size_t i = 0; i < old_slots.size(); ++i) {
+                        if (NULL == old_slots[i]) {
+                            continue;
+                        }
+
+                        size_t j = hash(old_slots[i]) & mask;
+                        while (NULL != slots_[j]) {
+                            j = (j + 1) & mask;
+                        }
+                        slots_[j] = old_slots[i];
+                    }
+                }
+
+            private:
+                std::vector<T*> slots_;
+                size_t size_;
+            };
+
+            /**
+            * @brief 可扩容的环形队列，容量总是2的幂
+            * @note 只在容量不足时扩容，push_back/pop_front不会申请内存
+            */
+            template<typename T>
+            class lru_ring_queue {
+            public:
+                lru_ring_queue() : head_(0), size_(0) {}
+
+                void push_back(const T& v) {
+                    if (size_ >= data_.size()) {
+                        expand();
+                    }
+
+                    data_[(head_ + size_) & (data_.size() - 1)] = v;
+                    ++size_;
+                }
+
+                void pop_front() {
+                    head_ = (head_ + 1) & (data_.size() - 1);
+                    --size_;
+                }
+
+                inline T& front() { return data_[head_]; }
+                inline const T& front() const { return data_[head_]; }
+                inline bool empty() const { return 0 == size_; }
+                inline size_t size() const { return size_; }
+                inline size_t capacity() const { return data_.size(); }
+
+                void clear() {
+                    head_ = 0;
+                    size_ = 0;
+                }
+
+            private:
+                void expand() {
+                    std::vector<T> new_data;
+                    new_data.resize(data_.empty() ? 16 : data_.size() * 2);
+                    for (size_t i = 0; i < size_; ++i) {
+                        new_data[i] = data_[(head_ + i) & (data_.size() - 1)];
+                    }
+
+                    data_.swap(new_data);
+                    head_ = 0;
+                }
+
+            private:
+                std::vector<T> data_;
+                size_t head_;
+                size_t size_;
+            };
+
+            /**
+            * @brief 分层时间轮，第0层256个槽，第1-3层各64个槽，时间单位是tick
+            * @note 超出范围的定时器放在最高层的最后一个槽，到期时重新计算位置
+            * @note 到期的数据进入就绪队列，由调用者分批取出，所以推进时间轮本身不会回调
+            */
+            template<typename T>
+            class lru_timer_wheel {
+            public:
+                enum {
+                    LEVEL0_BITS = 8,
+                    LEVELN_BITS = 6,
+                    LEVEL_NUM = 4,
+                    LEVEL0_SIZE = 1 << LEVEL0_BITS,
+                    LEVELN_SIZE = 1 << LEVELN_BITS
+                };
+
+                struct entry_t {
+                    uint64_t expire_tick;
+                    T data;
+                };
+
+                lru_timer_wheel() : current_tick_(0), count_(0) {
+                    for (int i = 0; i < LEVEL_NUM; ++i) {
+                        slots_[i].resize(0 == i ? LEVEL0_SIZE : LEVELN_SIZE);
+                        level_count_[i] = 0;
+                    }
+                }
+
+                /**
+                * @brief 添加定时器，已经到期的直接进入就绪队列
+                */
+                void add(uint64_t expire_tick, const T& data) {
+                    entry_t e;
+                    e.expire_tick = expire_tick;
+                    e.data = data;
+                    add_entry(e);
+                }
+
+                /**
+                * @brief 推进到指定tick，期间到期的定时器进入就绪队列
+                * @note 直接跳到下一个非空槽，空槽不需要逐tick走
+                */
+                void advance(uint64_t now_tick) {
+                    while (current_tick_ < now_tick) {
+                        uint64_t next_tick = next_event_tick();
+                        if (next_tick > now_tick) {
+                            current_tick_ = now_tick;
+                            break;
+                        }
+
+                        current_tick_ = next_tick;
+
+                        // 低位溢出时从高层向下迁移
+                        for (int l = 1; l < LEVEL_NUM; ++l) {
+                            if (0 != (current_tick_ & ((static_cast<uint64_t>(1) << shift(l)) - 1))) {
+                                break;
+                            }
+
+                            cascade(l, static_cast<size_t>((current_tick_ >> shift(l)) & (LEVELN_SIZE - 1)));
+                        }
+
+                        std::vector<entry_t>& slot = slots_[0][static_cast<size_t>(current_tick_ & (LEVEL0_SIZE - 1))];
+                        for (size_t i = 0; i < slot.size(); ++i) {
+                            ready_.push_back(slot[i]);
+                        }
+                        count_ -= slot.size();
+                        level_count_[0] -= slot.size();
+                        slot.clear();
+                    }
+                }
+
+                inline bool ready_empty() const { return ready_.empty(); }
+                inline size_t ready_size() const { return ready_.size(); }
+                inline const entry_t& ready_front() const { return ready_.front(); }
+                inline void ready_pop() { ready_.pop_front(); }
+
+                inline uint64_t current_tick() const { return current_tick_; }
+
+                /**
+                * @brief 时间轮中尚未到期的定时器数量，不包含就绪队列
+                */
+                inline size_t size() const { return count_; }
+
+                void clear() {
+                    for (int i = 0; i < LEVEL_NUM; ++i) {
+                        for (size_t j = 0; j < slots_[i].size(); ++j) {
+                            slots_[i][j].clear();
+                        }
+                        level_count_[i] = 0;
+                    }
+                    ready_.clear();
+                    count_ = 0;
+                }
+
+            private:
+                static inline int shift(int level) {
+                    return 0 == level ? 0 : (LEVEL0_BITS + (level - 1) * LEVELN_BITS);
+                }
+
+                /**
+                * @brief 下一个需要处理的tick（第0层槽到期或高层槽迁移），没有定时器时返回最大值
+                */
+                uint64_t next_event_tick() const {
+                    uint64_t ret = std::numeric_limits<uint64_t>::max();
+                    for (int l = 0; l < LEVEL_NUM; ++l) {
+                        if (0 == level_count_[l]) {
+                            continue;
+                        }
+
+                        size_t slot_num = slots_[l].size();
+                        uint64_t base = current_tick_ >> shift(l);
+                        for (size_t k = 1; k <= slot_num; ++k) {
+                            if (!slots_[l][static_cast<size_t>((base + k) & (slot_num - 1))].empty()) {
+                                uint64_t t = (base + k) << shift(l);
+                                ret = t < ret ? t : ret;
+                                break;
+                            }
+                        }
+                    }
+
+                    return ret;
+                }
+
+                void add_entry(const entry_t& e) {
+                    if (e.expire_tick <= current_tick_) {
+                        ready_.push_back(e);
+                        return;
+                    }
+
+                    if (e.expire_tick - current_tick_ < LEVEL0_SIZE) {
+                        slots_[0][static_cast<size_t>(e.expire_tick & (LEVEL0_SIZE - 1))].push_back(e);
+                        ++count_;
+                        ++level_count_[0];
+                        return;
+                    }
+
+                    // 按高位的差值选层，保证不会放进当前正在走的槽
+                    for (int l = 1; l < LEVEL_NUM; ++l) {
+                        if ((e.expire_tick >> shift(l)) - (current_tick_ >> shift(l)) < LEVELN_SIZE) {
+                            slots_[l][static_cast<size_t>((e.expire_tick >> shift(l)) & (LEVELN_SIZE - 1))].push_back(e);
+                            ++count_;
+                            ++level_count_[l];
+                            return;
+                        }
+                    }
+
+                    // 超出范围，放在最高层最远的槽
+                    int top = LEVEL_NUM - 1;
+                    slots_[top][static_cast<size_t>(((current_tick_ >> shift(top)) + LEVELN_SIZE - 1) & (LEVELN_SIZE - 1))].push_back(e);
+                    ++count_;
+                    ++level_count_[top];
+                }
+
+                void cascade(int level, size_t idx) {
+                    std::vector<entry_t> moved;
+                    moved.swap(slots_[level][idx]);
+                    count_ -= moved.size();
+                    level_count_[level] -= moved.size();
+                    for (size_t i = 0; i < moved.size(); ++i) {
+                        add_entry(moved[i]);
+                    }
+
+                    // 保留槽的内存
+                    moved.clear();
+                    if (slots_[level][idx].empty()) {
+                        slots_[level][idx].swap(moved);
+                    }
+                }
+
+            private:
+                std::vector<std::vector<entry_t> > slots_[LEVEL_NUM];
+                lru_ring_queue<entry_t> ready_;
+                uint64_t current_tick_;
+                size_t count_;
+                size_t level_count_[LEVEL_NUM];
+            };
+        }
+
         /**
         * 需要注意保证lru_pool_manager所引用的所有lru_pool仍然有效
         */
@@ -77,10 +475,54 @@ namespace util {
         public:
             typedef std::shared_ptr<lru_pool_manager> ptr_t;
 
+            /**
+            * @brief list句柄，高32位是版本号，低32位是槽位下标。0表示无效句柄
+            */
+            typedef uint64_t list_handle_t;
+
+            /**
+            * @brief 检查列表项，对应push_id开始的push_count个连续push的元素
+            */
             struct check_item_t {
                 uint64_t push_id;
                 time_t push_tick;
-                std::weak_ptr<lru_pool_base::list_type_base> list_;
+                list_handle_t list_handle;
+                uint32_t push_count;
+            };
+
+            /**
+            * @brief 统计数据类型
+            */
+            struct stat_type_t {
+                enum type {
+                    PUSH = 0,               // push次数
+                    PULL_HIT,               // pull命中次数
+                    PULL_MISS,              // pull未命中次数
+                    EVICT_ITEM_BOUND,       // 因元素数量超限回收的元素个数
+                    EVICT_LIST_BOUND,       // 因检查列表长度超限回收的元素个数
+                    EVICT_BYTE_BOUND,       // 因字节数超限回收的元素个数
+                    EVICT_TIMEOUT,          // 因超时回收的元素个数
+                    GC,                     // 主动gc()回收的元素个数（同时也会计入上面的原因）
+                    MAX
+                };
+            };
+
+            /**
+            * @brief 统计数据快照
+            * @note 计数器单调递增，阈值是最近一次proc/gc/自适应调整后的值
+            */
+            struct stat_t {
+                uint64_t counters[stat_type_t::MAX];
+
+                uint64_t item_count;
+                uint64_t list_count;
+                uint64_t byte_count;
+
+                uint64_t item_min_bound;
+                uint64_t item_max_bound;
+                uint64_t list_bound;
+                uint64_t proc_list_count;
+                uint64_t proc_item_count;
             };
 
         public:
@@ -99,6 +541,9 @@ namespace util {
             _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER(proc_item_count);
             _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER(gc_list);
             _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER(gc_item);
+            // 按字节数限制，0表示关闭。超过byte_max_bound后回收到不高于byte_min_bound
+            _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER(byte_max_bound);
+            _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER(byte_min_bound);
 
             void set_list_tick_timeout(time_t v) {
                 list_tick_timeout_ = v;
@@ -146,6 +591,43 @@ namespace util {
 
 #undef _UTIL_MEMPOOL_LRUOBJECTPOOL_SETTER_GETTER
 
+            /**
+            * @brief 单调时钟，返回纳秒
+            */
+            typedef uint64_t (*ttl_clock_fn_t)();
+
+            static uint64_t default_ttl_clock() {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+            }
+
+            /**
+            * @brief 设置TTL（纳秒），0表示关闭时间轮回收模式（默认）
+            * @note 开启后每个list只挂一个定时器，到期时间是list最旧元素的push时间+TTL
+            * @note 只对开启后push的对象生效，所以应该在push之前设置
+            */
+            void set_ttl(uint64_t ns) { ttl_ = ns; }
+            uint64_t get_ttl() const { return ttl_; }
+
+            /**
+            * @brief 设置时间轮的精度（纳秒），默认1毫秒。第0层覆盖256个tick，全部4层覆盖2^26个tick
+            * @note 只能在没有定时器时修改
+            */
+            void set_ttl_resolution(uint64_t ns) { ttl_resolution_ = ns > 0 ? ns : 1; }
+            uint64_t get_ttl_resolution() const { return ttl_resolution_; }
+
+            /**
+            * @brief 替换时钟，主要用于测试
+            */
+            void set_ttl_clock(ttl_clock_fn_t fn) { ttl_clock_ = NULL == fn ? default_ttl_clock : fn; }
+
+            /**
+            * @brief 获取TTL模式下的当前时间，未开启时返回0
+            */
+            inline uint64_t ttl_now() const {
+                return 0 == ttl_ ? 0 : ttl_clock_();
+            }
+
             /**
             * @brief 获取实例缓存数量
             * @note 如果不是非常了解这个数值的作用，请不要修改它
@@ -160,6 +642,66 @@ namespace util {
             inline util::lock::seq_alloc_u64& list_count() { return list_count_; }
             inline const util::lock::seq_alloc_u64& list_count() const { return list_count_; }
 
+            /**
+            * @brief 获取缓存的总字节数，由TAction::size(TObj*)统计
+            * @note 如果不是非常了解这个数值的作用，请不要修改它
+            */
+            inline util::lock::seq_alloc_u64& byte_count() { return byte_count_; }
+            inline const util::lock::seq_alloc_u64& byte_count() const { return byte_count_; }
+
+            /**
+            * @brief 设置后台回收器，为空时在当前线程回收（默认）
+            * @note 开启后TAction::gc会在回收线程执行，必须是线程安全的
+            */
+            inline void set_reclaimer(const std::shared_ptr<lru_reclaimer_base>& r) { reclaimer_ = r; }
+            inline const std::shared_ptr<lru_reclaimer_base>& get_reclaimer() const { return reclaimer_; }
+
+            /**
+            * @brief 把对象交给回收器
+            * @return 没有回收器或回收器拒绝时返回false，调用者需要自行回收
+            */
+            inline bool reclaim(lru_reclaimer_base::reclaim_fn_t fn, void* obj) {
+                return reclaimer_ && reclaimer_->push(fn, obj);
+            }
+
+            /**
+            * @brief 开启或关闭统计，默认关闭
+            * @note 关闭时push/pull/回收路径上只多一次分支判断
+            */
+            inline void set_enable_stat(bool v) { enable_stat_ = v; }
+            inline bool get_enable_stat() const { return enable_stat_; }
+
+            /**
+            * @brief 增加统计计数
+            */
+            inline void add_stat(stat_type_t::type t, uint64_t v = 1) {
+                if (enable_stat_) {
+                    stat_counters_[t].add(v, util::lock::memory_order_relaxed);
+                }
+            }
+
+            /**
+            * @brief 获取统计数据快照，可以在其他线程调用
+            * @note 每个值都是原子读取，但快照整体不是一个原子操作
+            */
+            stat_t get_stat() const {
+                stat_t ret;
+                for (int i = 0; i < stat_type_t::MAX; ++i) {
+                    ret.counters[i] = stat_counters_[i].get(util::lock::memory_order_relaxed);
+                }
+
+                ret.item_count = item_count_.get(util::lock::memory_order_relaxed);
+                ret.list_count = list_count_.get(util::lock::memory_order_relaxed);
+                ret.byte_count = byte_count_.get(util::lock::memory_order_relaxed);
+
+                ret.item_min_bound = stat_bounds_[0].get(util::lock::memory_order_relaxed);
+                ret.item_max_bound = stat_bounds_[1].get(util::lock::memory_order_relaxed);
+                ret.list_bound = stat_bounds_[2].get(util::lock::memory_order_relaxed);
+                ret.proc_list_count = stat_bounds_[3].get(util::lock::memory_order_relaxed);
+                ret.proc_item_count = stat_bounds_[4].get(util::lock::memory_order_relaxed);
+                return ret;
+            }
+
             /**
             * @brief 主动GC，会触发阈值自适应
             * @return 此次调用回收的元素的个数
@@ -176,8 +718,8 @@ namespace util {
                 }
 
                 if (gc_list_ <= 0 && gc_item_ <= 0) {
-                    item_min_bound_ = (item_count_.get() + item_min_bound_) / 2;
-                    item_max_bound_ = (item_count_.get() + item_max_bound_ + 1) / 2;
+                    item_min_bound_ = (item_count_.get(util::lock::memory_order_relaxed) + item_min_bound_) / 2;
+                    item_max_bound_ = (item_count_.get(util::lock::memory_order_relaxed) + item_max_bound_ + 1) / 2;
 
                     if (item_min_bound_ > item_adjust_max_ - 1) {
                         item_min_bound_ = item_adjust_max_ - 1;
@@ -191,7 +733,7 @@ namespace util {
                         item_max_bound_ = item_adjust_min_ + 1;
                     }
 
-                    list_bound_ = (list_count_.get() + list_bound_ + 1) / 2;
+                    list_bound_ = (list_count_.get(util::lock::memory_order_relaxed) + list_bound_ + 1) / 2;
                     if (list_bound_ < list_adjust_min_) {
                         list_bound_ = list_adjust_min_;
                     }
@@ -204,7 +746,9 @@ namespace util {
                     gc_item_ = item_min_bound_;
                 }
 
-                return proc(last_proc_tick_);
+                size_t ret = proc(last_proc_tick_);
+                add_stat(stat_type_t::GC, ret);
+                return ret;
             }
 
             /**
@@ -214,15 +758,25 @@ namespace util {
             */
             size_t proc(time_t tick) {
                 last_proc_tick_ = tick;
+                publish_bounds();
 
-                if (gc_list_ <= 0 && gc_item_ <= 0) {
+                if (check_byte_bound()) {
+                    gc_byte_ = true;
+                }
+
+                // TTL模式下先回收到期的list，和检查列表的回收互不影响
+                size_t ret = 0;
+                if (0 != ttl_) {
+                    ret += proc_ttl(ttl_clock_());
+                }
+
+                if (gc_list_ <= 0 && gc_item_ <= 0 && !gc_byte_) {
                     // 如果没有失效的check list缓存则不用继续走资源回收流程
                     if (checked_list_.empty() || check_tick(checked_list_.front().push_tick)) {
-                        return 0;
+                        return ret;
                     }
                 }
 
-                size_t ret = 0;
                 size_t left_list_num = proc_list_count_;
                 size_t left_item_num = proc_item_count_;
 
@@ -235,50 +789,109 @@ namespace util {
                         break;
                     }
 
-                    if (0 != gc_item_ && item_count_.get() <= gc_item_) {
+                    if (0 != gc_item_ && item_count_.get(util::lock::memory_order_relaxed) <= gc_item_) {
                         gc_item_ = 0;
                     }
 
-                    if (0 != gc_list_ && list_count_.get() <= gc_list_) {
+                    if (0 != gc_list_ && list_count_.get(util::lock::memory_order_relaxed) <= gc_list_) {
                         gc_list_ = 0;
                     }
 
-                    if (0 == gc_item_ && 0 == gc_list_) {
+                    if (gc_byte_ && byte_count_.get(util::lock::memory_order_relaxed) <= byte_min_bound_) {
+                        gc_byte_ = false;
+                    }
+
+                    if (0 == gc_item_ && 0 == gc_list_ && !gc_byte_) {
                         // 如果没有失效的check list缓存则后续流程也可以取消
                         if (checked_list_.empty() || check_tick(checked_list_.front().push_tick)) {
                             break;
                         }
                     }
 
+                    // 计数仍然包含已关联但没有检查项的lru_pool里的对象，不能清零，否则它们之后的sub会让计数回绕
                     if (checked_list_.empty()) {
                         gc_list_ = 0;
                         gc_item_ = 0;
-                        list_count_.set(0);
-                        item_count_.set(0);
+                        gc_byte_ = false;
                         break;
                     }
 
-                    check_item_t checked_item = checked_list_.front();
-                    checked_list_.pop_front();
-                    list_count_.dec();
-                    --left_list_num;
-
-                    if (checked_item.list_.expired()) {
+                    // 批量push的检查项可能需要回收多次，全部回收或失效后才出队
+                    check_item_t& checked_item = checked_list_.front();
+                    lru_pool_base::list_type_base* tar_ls = get_list(checked_item.list_handle);
+                    uint64_t tail_id = NULL == tar_ls ? 0 : tar_ls->tail_id();
+                    if (NULL == tar_ls || tail_id < checked_item.push_id || tail_id - checked_item.push_id >= checked_item.push_count) {
+                        checked_list_.pop_front();
+                        list_count_.dec(util::lock::memory_order_relaxed);
+                        --left_list_num;
                         continue;
                     }
 
-                    std::shared_ptr<lru_pool_base::list_type_base> tar_ls = checked_item.list_.lock();
-                    if (!tar_ls) {
-                        continue;
+                    if (tail_id - checked_item.push_id + 1 >= checked_item.push_count) {
+                        checked_list_.pop_front();
+                        list_count_.dec(util::lock::memory_order_relaxed);
+                        --left_list_num;
                     }
 
-                    if (tar_ls->tail_id() != checked_item.push_id) {
+                    if (tar_ls->gc()) {
+                        ++ret;
+                        --left_item_num;
+
+                        if (0 != gc_item_) {
+                            add_stat(stat_type_t::EVICT_ITEM_BOUND);
+                        } else if (0 != gc_list_) {
+                            add_stat(stat_type_t::EVICT_LIST_BOUND);
+                        } else if (gc_byte_) {
+                            add_stat(stat_type_t::EVICT_BYTE_BOUND);
+                        } else {
+                            add_stat(stat_type_t::EVICT_TIMEOUT);
+                        }
+                    }
+                }
+
+                return ret;
+            }
+
+            /**
+            * @brief 回收TTL到期的对象
+            * @param now 单调时钟的当前时间（纳秒）
+            * @return 此次调用回收的元素的个数，每次最多回收proc_item_count个，剩余的下次调用继续
+            */
+            size_t proc_ttl(uint64_t now) {
+                if (0 == ttl_) {
+                    return 0;
+                }
+
+                ttl_wheel_.advance(now / ttl_resolution_);
+
+                size_t ret = 0;
+                size_t left_item_num = proc_item_count_;
+                // 重新加入就绪队列的定时器留到下次处理
+                size_t left_timer_num = ttl_wheel_.ready_size();
+
+                while (left_item_num > 0 && left_timer_num > 0) {
+                    list_handle_t h = ttl_wheel_.ready_front().data;
+                    ttl_wheel_.ready_pop();
+                    --left_timer_num;
+
+                    lru_pool_base::list_type_base* tar_ls = get_list(h);
+                    if (NULL == tar_ls) {
                         continue;
                     }
 
-                    if (tar_ls->gc()) {
+                    list_slots_[static_cast<uint32_t>(h & 0xFFFFFFFF)].ttl_pending = false;
+                    while (left_item_num > 0 && !tar_ls->empty() && tar_ls->tail_push_time() + ttl_ <= now) {
+                        if (!tar_ls->gc()) {
+                            break;
+                        }
+
                         ++ret;
                         --left_item_num;
+                        add_stat(stat_type_t::EVICT_TIMEOUT);
+                    }
+
+                    if (!tar_ls->empty()) {
+                        push_ttl_list(h, tar_ls->tail_push_time());
                     }
                 }
 
@@ -286,42 +899,136 @@ namespace util {
             }
 
             /**
-            * @brief 添加检查列表
+            * @brief 为list挂TTL定时器，已经挂了定时器的list不会重复添加
+            * @param push_time list最旧元素的push时间
             */
-            void push_check_list(uint64_t push_id, std::weak_ptr<lru_pool_base::list_type_base> list_) {
-                checked_list_.push_back(check_item_t());
-                checked_list_.back().push_id = push_id;
-                checked_list_.back().list_ = list_;
-                checked_list_.back().push_tick = last_proc_tick_;
+            void push_ttl_list(list_handle_t list_handle, uint64_t push_time) {
+                if (0 == ttl_ || NULL == get_list(list_handle)) {
+                    return;
+                }
 
-                list_count_.inc();
+                list_slot_t& slot = list_slots_[static_cast<uint32_t>(list_handle & 0xFFFFFFFF)];
+                if (slot.ttl_pending) {
+                    return;
+                }
 
-                if (item_count_.get() > item_max_bound_) {
+                slot.ttl_pending = true;
+                // 向上取整，保证不会提前触发
+                ttl_wheel_.add((push_time + ttl_ + ttl_resolution_ - 1) / ttl_resolution_, list_handle);
+            }
+
+            /**
+            * @brief 添加检查列表
+            * @param push_time TTL模式下的push时间，由ttl_now()获取
+            * @param push_count 从push_id开始连续push的元素个数
+            */
+            void push_check_list(uint64_t push_id, list_handle_t list_handle, uint64_t push_time = 0, uint32_t push_count = 1) {
+                check_item_t item;
+                item.push_id = push_id;
+                item.push_tick = last_proc_tick_;
+                item.list_handle = list_handle;
+                item.push_count = push_count;
+                checked_list_.push_back(item);
+
+                list_count_.inc(util::lock::memory_order_relaxed);
+                add_stat(stat_type_t::PUSH, push_count);
+
+                if (0 != ttl_) {
+                    push_ttl_list(list_handle, push_time);
+                }
+
+                if (item_count_.get(util::lock::memory_order_relaxed) > item_max_bound_) {
                     inner_gc();
 
                     // 自适应，慢速增大上限值
                     if (item_max_bound_ < item_adjust_max_) {
                         ++item_max_bound_;
                     }
-                } else if (list_count_.get() > list_bound_) {
+                    publish_bounds();
+                } else if (list_count_.get(util::lock::memory_order_relaxed) > list_bound_) {
                     inner_gc();
 
                     // 自适应，慢速增大上限值
                     if (list_bound_ < list_adjust_max_) {
                         ++list_bound_;
                     }
+                    publish_bounds();
+                }
+
+                // 按字节数限制，回收到byte_min_bound以下
+                if (check_byte_bound()) {
+                    gc_byte_ = true;
+                    proc(last_proc_tick_);
                 }
             }
 
+            /**
+            * @brief 注册list，返回的句柄用于检查列表
+            * @note list析构或切换管理器前必须调用unregister_list
+            */
+            list_handle_t register_list(lru_pool_base::list_type_base* ls) {
+                uint32_t idx;
+                if (free_list_slots_.empty()) {
+                    idx = static_cast<uint32_t>(list_slots_.size());
+                    list_slots_.push_back(list_slot_t());
+                    list_slots_.back().generation = 0;
+                } else {
+                    idx = free_list_slots_.back();
+                    free_list_slots_.pop_back();
+                }
+
+                list_slot_t& slot = list_slots_[idx];
+                // 版本号跳过0，保证句柄不会为0
+                if (0 == ++slot.generation) {
+                    ++slot.generation;
+                }
+                slot.list = ls;
+                slot.ttl_pending = false;
+
+                return (static_cast<list_handle_t>(slot.generation) << 32) | idx;
+            }
+
+            /**
+            * @brief 注销list，检查列表中残留的该句柄会失效
+            */
+            void unregister_list(list_handle_t h) {
+                uint32_t idx = static_cast<uint32_t>(h & 0xFFFFFFFF);
+                if (NULL == get_list(h)) {
+                    return;
+                }
+
+                list_slots_[idx].list = NULL;
+                if (0 == ++list_slots_[idx].generation) {
+                    ++list_slots_[idx].generation;
+                }
+                free_list_slots_.push_back(idx);
+            }
+
+            /**
+            * @brief 通过句柄获取list，句柄已失效则返回NULL
+            */
+            inline lru_pool_base::list_type_base* get_list(list_handle_t h) const {
+                uint32_t idx = static_cast<uint32_t>(h & 0xFFFFFFFF);
+                if (idx >= list_slots_.size() || list_slots_[idx].generation != static_cast<uint32_t>(h >> 32)) {
+                    return NULL;
+                }
+
+                return list_slots_[idx].list;
+            }
+
         private:
             lru_pool_manager() :item_min_bound_(0), item_max_bound_(1024),
                 list_bound_(2048), proc_list_count_(16), proc_item_count_(16),
                 gc_list_(0), gc_item_(0),
+                byte_max_bound_(0), byte_min_bound_(0), gc_byte_(false),
                 item_adjust_min_(256), item_adjust_max_(std::numeric_limits<size_t>::max()),
                 list_adjust_min_(512), list_adjust_max_(std::numeric_limits<size_t>::max()),
-                last_proc_tick_(0), list_tick_timeout_(0) {
+                last_proc_tick_(0), list_tick_timeout_(0),
+                ttl_(0), ttl_resolution_(1000000), ttl_clock_(default_ttl_clock), enable_stat_(false) {
                 item_count_.set(0);
                 list_count_.set(0);
+                byte_count_.set(0);
+                publish_bounds();
             }
 
             lru_pool_manager(const lru_pool_manager&);
@@ -339,21 +1046,46 @@ namespace util {
                 return proc(last_proc_tick_);
             }
 
+            // 自适应阈值只在管理器所在线程修改，复制一份原子变量用于其他线程读取快照
+            inline void publish_bounds() {
+                stat_bounds_[0].set(item_min_bound_, util::lock::memory_order_relaxed);
+                stat_bounds_[1].set(item_max_bound_, util::lock::memory_order_relaxed);
+                stat_bounds_[2].set(list_bound_, util::lock::memory_order_relaxed);
+                stat_bounds_[3].set(proc_list_count_, util::lock::memory_order_relaxed);
+                stat_bounds_[4].set(proc_item_count_, util::lock::memory_order_relaxed);
+            }
+
+            inline bool check_byte_bound() {
+                return 0 != byte_max_bound_ && byte_count_.get(util::lock::memory_order_relaxed) > byte_max_bound_;
+            }
+
             inline bool check_tick(time_t tp) {
                 using std::abs;
                 return 0 == list_tick_timeout_ || abs(last_proc_tick_ - tp) <= list_tick_timeout_;
             }
         private:
+            struct list_slot_t {
+                lru_pool_base::list_type_base* list;
+                uint32_t generation;
+                bool ttl_pending;
+            };
+
             size_t item_min_bound_;
             size_t item_max_bound_;
-            util::lock::seq_alloc_u64 item_count_;
+            util::lock::padded_seq_alloc_u64 item_count_;
             size_t list_bound_;
-            util::lock::seq_alloc_u64 list_count_;
+            util::lock::padded_seq_alloc_u64 list_count_;
             size_t proc_list_count_;
             size_t proc_item_count_;
             size_t gc_list_;
             size_t gc_item_;
-            std::list<check_item_t> checked_list_;
+            size_t byte_max_bound_;
+            size_t byte_min_bound_;
+            util::lock::padded_seq_alloc_u64 byte_count_;
+            bool gc_byte_;
+            detail::lru_ring_queue<check_item_t> checked_list_;
+            std::vector<list_slot_t> list_slots_;
+            std::vector<uint32_t> free_list_slots_;
 
             // 自适应下限
             size_t item_adjust_min_;
@@ -364,8 +1096,24 @@ namespace util {
             // 检查列表，tick有效期
             time_t last_proc_tick_;
             time_t list_tick_timeout_;
+
+            // TTL时间轮，定时器的数据是list句柄
+            uint64_t ttl_;
+            uint64_t ttl_resolution_;
+            ttl_clock_fn_t ttl_clock_;
+            detail::lru_timer_wheel<list_handle_t> ttl_wheel_;
+
+            std::shared_ptr<lru_reclaimer_base> reclaimer_;
+
+            // 统计数据
+            bool enable_stat_;
+            util::lock::seq_alloc_u64 stat_counters_[stat_type_t::MAX];
+            util::lock::seq_alloc_u64 stat_bounds_[5];
         };
 
+        /**
+        * @note 可选提供 size_t size(TObj* obj) 接口，返回对象占用的字节数，用于lru_pool_manager按字节数限制缓存
+        */
         template<typename TObj>
         struct lru_default_action {
             void push(TObj* obj) {}
@@ -376,20 +1124,259 @@ namespace util {
             }
         };
 
-        template<typename TKey, typename TObj, typename TAction = lru_default_action<TObj> >
+        namespace detail {
+            /**
+            * @brief 检测TAction是否提供size(TObj*)接口
+            */
+            template<typename TAction, typename TObj>
+            struct lru_action_has_size {
+                template<typename U>
+                static char test(decltype(static_cast<size_t>(std::declval<U&>().size(std::declval<TObj*>())))*);
+
+                template<typename U>
+                static long test(...);
+
+                static const bool value = sizeof(test<TAction>(0)) == sizeof(char);
+            };
+
+            template<typename TAction, typename TObj, bool has_size = lru_action_has_size<TAction, TObj>::value>
+            struct lru_action_size {
+                static inline size_t size(TAction& act, TObj* obj) {
+                    return static_cast<size_t>(act.size(obj));
+                }
+            };
+
+            template<typename TAction, typename TObj>
+            struct lru_action_size<TAction, TObj, false> {
+                static inline size_t size(TAction&, TObj*) {
+                    return 0;
+                }
+            };
+        }
+
+        namespace detail {
+            /**
+            * @brief 基于std::list的节点容器，每个节点单独申请和释放内存
+            */
+            template<typename T>
+            class lru_std_list_container {
+            public:
+                struct allocator_type {};
+
+                explicit lru_std_list_container(allocator_type*) {}
+
+                inline void push_front(const T& v) { data_.push_front(v); }
+                inline void pop_front() { data_.pop_front(); }
+                inline void pop_back() { data_.pop_back(); }
+                inline T& front() { return data_.front(); }
+                inline const T& front() const { return data_.front(); }
+                inline T& back() { return data_.back(); }
+                inline const T& back() const { return data_.back(); }
+                inline bool empty() const { return data_.empty(); }
+                inline size_t size() const { return data_.size(); }
+
+            private:
+                std::list<T> data_;
+            };
+
+            /**
+            * @brief slab节点分配器，按块申请节点内存，释放的节点进入空闲链表复用
+            * @note 块内存只在分配器析构时释放
+            */
+            template<typename T, size_t CHUNK_SIZE>
+            class lru_slab_node_allocator {
+            public:
+                struct node_type {
+                    T data;
+                    node_type* prev;
+                    node_type* next;
+                };
+
+                lru_slab_node_allocator() : free_list_(NULL), free_count_(0) {}
+
+                ~lru_slab_node_allocator() {
+                    for (size_t i = 0; i < chunks_.size(); ++i) {
+                        delete[] chunks_[i];
+                    }
+                    chunks_.clear();
+                    free_list_ = NULL;
+                    free_count_ = 0;
+                }
+
+                node_type* allocate() {
+                    if (NULL == free_list_) {
+                        expand();
+                    }
+
+                    node_type* ret = free_list_;
+                    free_list_ = ret->next;
+                    --free_count_;
+                    return ret;
+                }
+
+                void deallocate(node_type* n) {
+                    n->prev = NULL;
+                    n->next = free_list_;
+                    free_list_ = n;
+                    ++free_count_;
+                }
+
+                /**
+                * @brief 空闲节点数量
+                */
+                inline size_t free_count() const { return free_count_; }
+
+                /**
+                * @brief 已申请的节点总数
+                */
+                inline size_t capacity() const { return chunks_.size() * CHUNK_SIZE; }
+
+            private:
+                lru_slab_node_allocator(const lru_slab_node_allocator&);
+                lru_slab_node_allocator& operator=(const lru_slab_node_allocator&);
+
+                void expand() {
+                    node_type* chunk = new node_type[CHUNK_SIZE];
+                    chunks_.push_back(chunk);
+
+                    for (size_t i = CHUNK_SIZE; i > 0; --i) {
+                        deallocate(&chunk[i - 1]);
+                    }
+                }
+
+            private:
+                node_type* free_list_;
+                size_t free_count_;
+                std::vector<node_type*> chunks_;
+            };
+
+            /**
+            * @brief 侵入式双向链表容器，节点由所属lru_pool的slab分配器提供
+            */
+            template<typename T, size_t CHUNK_SIZE>
+            class lru_slab_list_container {
+            public:
+                typedef lru_slab_node_allocator<T, CHUNK_SIZE> allocator_type;
+                typedef typename allocator_type::node_type node_type;
+
+                explicit lru_slab_list_container(allocator_type* alloc) : alloc_(alloc), head_(NULL), tail_(NULL), size_(0) {}
+
+                ~lru_slab_list_container() {
+                    while (!empty()) {
+                        pop_back();
+                    }
+                }
+
+                void push_front(const T& v) {
+                    node_type* n = alloc_->allocate();
+                    n->data = v;
+                    n->prev = NULL;
+                    n->next = head_;
+                    if (NULL != head_) {
+                        head_->prev = n;
+                    } else {
+                        tail_ = n;
+                    }
+                    head_ = n;
+                    ++size_;
+                }
+
+                void pop_front() {
+                    node_type* n = head_;
+                    head_ = n->next;
+                    if (NULL != head_) {
+                        head_->prev = NULL;
+                    } else {
+                        tail_ = NULL;
+                    }
+                    --size_;
+                    alloc_->deallocate(n);
+                }
+
+                void pop_back() {
+                    node_type* n = tail_;
+                    tail_ = n->prev;
+                    if (NULL != tail_) {
+                        tail_->next = NULL;
+                    } else {
+                        head_ = NULL;
+                    }
+                    --size_;
+                    alloc_->deallocate(n);
+                }
+
+                inline T& front() { return head_->data; }
+                inline const T& front() const { return head_->data; }
+                inline T& back() { return tail_->data; }
+                inline const T& back() const { return tail_->data; }
+                inline bool empty() const { return NULL == head_; }
+                inline size_t size() const { return size_; }
+
+            private:
+                lru_slab_list_container(const lru_slab_list_container&);
+                lru_slab_list_container& operator=(const lru_slab_list_container&);
+
+                allocator_type* alloc_;
+                node_type* head_;
+                node_type* tail_;
+                size_t size_;
+            };
+        }
+
+        /**
+        * @brief 节点存储策略：std::list，每次push/pull都会申请/释放一个链表节点
+        */
+        struct lru_std_list_storage {
+            template<typename T>
+            struct container {
+                typedef detail::lru_std_list_container<T> type;
+            };
+        };
+
+        /**
+        * @brief 节点存储策略：slab空闲链表，节点按CHUNK_SIZE个一块申请并在lru_pool内复用
+        * @note 稳定状态下push/pull只做指针交换，不会申请内存
+        */
+        template<size_t CHUNK_SIZE = 64>
+        struct lru_slab_list_storage {
+            template<typename T>
+            struct container {
+                typedef detail::lru_slab_list_container<T, CHUNK_SIZE> type;
+            };
+        };
+
+        template<typename TKey, typename TObj, typename TAction = lru_default_action<TObj>, typename TStorage = lru_std_list_storage>
         class lru_pool : public lru_pool_base {
         public:
             typedef TKey key_t;
             typedef TObj value_type;
             typedef TAction action_type;
+            typedef TStorage storage_type;
 
             class list_type : public lru_pool_base::list_type_base {
             public:
                 struct wrapper {
                     value_type* object;
                     uint64_t push_id;
+                    uint64_t push_time;
+                    size_t bytes;
                 };
 
+                typedef typename storage_type::template container<wrapper>::type container_type;
+                typedef typename container_type::allocator_type allocator_type;
+
+                list_type(lru_pool<TKey, TObj, TAction, TStorage>* owner, const key_t& id) : owner_(owner), id_(id), mgr_handle_(0), byte_size_(0), cache_(&owner->node_alloc_) {
+                    if (owner_->mgr_) {
+                        mgr_handle_ = owner_->mgr_->register_list(this);
+                    }
+                }
+
+                virtual ~list_type() {
+                    if (owner_->mgr_ && 0 != mgr_handle_) {
+                        owner_->mgr_->unregister_list(mgr_handle_);
+                    }
+                }
+
                 virtual uint64_t tail_id() const {
                     if (cache_.empty()) {
                         return 0;
@@ -398,6 +1385,14 @@ namespace util {
                     return cache_.back().push_id;
                 }
 
+                virtual uint64_t tail_push_time() const {
+                    if (cache_.empty()) {
+                        return 0;
+                    }
+
+                    return cache_.back().push_time;
+                }
+
                 virtual size_t size() const {
                     return cache_.size();
                 };
@@ -409,12 +1404,19 @@ namespace util {
 
                     wrapper obj = cache_.back();
                     cache_.pop_back();
+                    byte_size_ -= obj.bytes;
 
-                    TAction act;
-                    act.gc(obj.object);
+                    --owner_->item_count_;
+                    owner_->byte_size_ -= obj.bytes;
+
+                    if (!owner_->mgr_ || !owner_->mgr_->reclaim(reclaim_fn, obj.object)) {
+                        TAction act;
+                        act.gc(obj.object);
+                    }
 
                     if (owner_->mgr_) {
-                        owner_->mgr_->item_count().dec();
+                        owner_->mgr_->item_count().dec(util::lock::memory_order_relaxed);
+                        owner_->mgr_->byte_count().sub(obj.bytes, util::lock::memory_order_relaxed);
                     }
 
 #ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
@@ -430,9 +1432,16 @@ namespace util {
                     return cache_.empty();
                 }
 
-                lru_pool<TKey, TObj, TAction>* owner_;
+                static void reclaim_fn(void* obj) {
+                    TAction act;
+                    act.gc(static_cast<value_type*>(obj));
+                }
+
+                lru_pool<TKey, TObj, TAction, TStorage>* owner_;
                 key_t id_;
-                std::list<wrapper> cache_;
+                lru_pool_manager::list_handle_t mgr_handle_;
+                size_t byte_size_;
+                container_type cache_;
             };
 
             typedef std::shared_ptr<list_type> list_ptr_type;
@@ -443,7 +1452,7 @@ namespace util {
             lru_pool& operator=(const lru_pool&);
 
         public:
-            lru_pool() {
+            lru_pool() : item_count_(0), byte_size_(0) {
                 push_id_alloc_.set(0);
             }
 
@@ -469,26 +1478,37 @@ namespace util {
             }
 
             void set_manager(lru_pool_manager::ptr_t m) {
-                size_t s = 0;
-                for (typename cat_map_type::iterator iter = data_.begin(); iter != data_.end(); ++iter) {
-                    if (iter->second) {
-                        s += iter->second->size();
-                    }
-                }
-
                 if (mgr_) {
-                    mgr_->item_count().sub(s);
+                    mgr_->item_count().sub(item_count_, util::lock::memory_order_relaxed);
+                    mgr_->byte_count().sub(byte_size_, util::lock::memory_order_relaxed);
+
+                    for (typename cat_map_type::iterator iter = data_.begin(); iter != data_.end(); ++iter) {
+                        if (iter->second && 0 != iter->second->mgr_handle_) {
+                            mgr_->unregister_list(iter->second->mgr_handle_);
+                            iter->second->mgr_handle_ = 0;
+                        }
+                    }
                 }
 
                 mgr_ = m;
                 if (m) {
-                    m->item_count().add(s);
+                    m->item_count().add(item_count_, util::lock::memory_order_relaxed);
+                    m->byte_count().add(byte_size_, util::lock::memory_order_relaxed);
+
+                    for (typename cat_map_type::iterator iter = data_.begin(); iter != data_.end(); ++iter) {
+                        if (iter->second) {
+                            iter->second->mgr_handle_ = m->register_list(iter->second.get());
+                            if (!iter->second->empty()) {
+                                m->push_ttl_list(iter->second->mgr_handle_, iter->second->tail_push_time());
+                            }
+                        }
+                    }
                 }
             }
 
             bool push(key_t id, TObj* obj) {
 #ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
-                if (check_pushed_.find(obj) != check_pushed_.end()) {
+                if (check_pushed_.contains(obj)) {
                     return false;
                 }
 #endif
@@ -498,31 +1518,34 @@ namespace util {
 
                 list_ptr_type& list_ = data_[id];
                 if (!list_) {
-                    list_ = std::make_shared<list_type>();
+                    list_ = std::make_shared<list_type>(this, id);
                     if (!list_) {
                         return false;
                     }
-
-                    list_->owner_ = this;
-                    list_->id_ = id;
                 }
 
+                TAction act;
                 typename list_type::wrapper obj_wrapper;
                 
                 obj_wrapper.object = obj;
-                while (0 == (obj_wrapper.push_id = push_id_alloc_.inc()));
+                obj_wrapper.push_time = mgr_ ? mgr_->ttl_now() : 0;
+                obj_wrapper.bytes = detail::lru_action_size<TAction, TObj>::size(act, obj);
+                while (0 == (obj_wrapper.push_id = push_id_alloc_.inc(util::lock::memory_order_relaxed)));
 
                 // 推送node, FILO
                 list_->cache_.push_front(obj_wrapper);
+                list_->byte_size_ += obj_wrapper.bytes;
+                ++item_count_;
+                byte_size_ += obj_wrapper.bytes;
 
-                TAction act;
                 act.push(obj);
 
                 if (mgr_) {
-                    mgr_->item_count().inc();
+                    mgr_->item_count().inc(util::lock::memory_order_relaxed);
+                    mgr_->byte_count().add(obj_wrapper.bytes, util::lock::memory_order_relaxed);
 
                     // 推送check list
-                    mgr_->push_check_list(obj_wrapper.push_id, std::dynamic_pointer_cast<lru_pool_base::list_type_base>(list_));
+                    mgr_->push_check_list(obj_wrapper.push_id, list_->mgr_handle_, obj_wrapper.push_time);
                 }
 
 #ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
@@ -532,27 +1555,112 @@ namespace util {
                 return true;
             }
 
+            /**
+            * @brief 批量push，同一个key只查找一次，每批只占用一个检查列表项
+            * @param begin,end TObj*的迭代器，NULL（和开启检测时重复push）的对象会被跳过
+            * @return 成功push的个数
+            */
+            template<typename TIter>
+            size_t push_n(key_t id, TIter begin, TIter end) {
+                if (begin == end) {
+                    return 0;
+                }
+
+                list_ptr_type& list_ = data_[id];
+                if (!list_) {
+                    list_ = std::make_shared<list_type>(this, id);
+                    if (!list_) {
+                        return 0;
+                    }
+                }
+
+                TAction act;
+                typename list_type::wrapper obj_wrapper;
+                obj_wrapper.push_time = mgr_ ? mgr_->ttl_now() : 0;
+
+                size_t ret = 0;
+                size_t batch_count = 0;
+                size_t batch_bytes = 0;
+                uint64_t first_id = 0;
+                for (TIter iter = begin; iter != end; ++iter) {
+                    TObj* obj = *iter;
+                    if (NULL == obj) {
+                        continue;
+                    }
+#ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
+                    if (!check_pushed_.insert(obj)) {
+                        continue;
+                    }
+#endif
+
+                    uint64_t push_id;
+                    while (0 == (push_id = push_id_alloc_.inc(util::lock::memory_order_relaxed)));
+
+                    // 一个检查列表项只能覆盖连续的push_id，且最多2^32-1个
+                    if (batch_count > 0 && (push_id != obj_wrapper.push_id + 1 || batch_count >= std::numeric_limits<uint32_t>::max())) {
+                        commit_push_n(*list_, first_id, batch_count, batch_bytes, obj_wrapper.push_time);
+                        batch_count = 0;
+                        batch_bytes = 0;
+                    }
+
+                    if (0 == batch_count) {
+                        first_id = push_id;
+                    }
+
+                    obj_wrapper.object = obj;
+                    obj_wrapper.push_id = push_id;
+                    obj_wrapper.bytes = detail::lru_action_size<TAction, TObj>::size(act, obj);
+                    list_->cache_.push_front(obj_wrapper);
+                    ++batch_count;
+                    batch_bytes += obj_wrapper.bytes;
+                    ++ret;
+
+                    act.push(obj);
+                }
+
+                if (batch_count > 0) {
+                    commit_push_n(*list_, first_id, batch_count, batch_bytes, obj_wrapper.push_time);
+                }
+
+                if (list_->empty()) {
+                    data_.erase(id);
+                }
+
+                return ret;
+            }
+
             TObj* pull(key_t id) {
                 typename cat_map_type::iterator iter = data_.find(id);
                 if (iter == data_.end()) {
+                    if (mgr_) {
+                        mgr_->add_stat(lru_pool_manager::stat_type_t::PULL_MISS);
+                    }
                     return NULL;
                 }
 
                 if (!iter->second || iter->second->cache_.empty()) {
                     data_.erase(iter);
+                    if (mgr_) {
+                        mgr_->add_stat(lru_pool_manager::stat_type_t::PULL_MISS);
+                    }
                     return NULL;
                 }
 
                 // 拉取node, FILO
                 typename list_type::wrapper obj_wrapper = iter->second->cache_.front();
                 iter->second->cache_.pop_front();
+                iter->second->byte_size_ -= obj_wrapper.bytes;
+                --item_count_;
+                byte_size_ -= obj_wrapper.bytes;
 
                 TAction act;
                 act.pull(obj_wrapper.object);
                 act.reset(obj_wrapper.object);
 
                 if (mgr_) {
-                    mgr_->item_count().dec();
+                    mgr_->item_count().dec(util::lock::memory_order_relaxed);
+                    mgr_->byte_count().sub(obj_wrapper.bytes, util::lock::memory_order_relaxed);
+                    mgr_->add_stat(lru_pool_manager::stat_type_t::PULL_HIT);
                 }
 
 #ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
@@ -566,6 +1674,55 @@ namespace util {
                 return obj_wrapper.object;
             }
 
+            /**
+            * @brief 批量pull，同一个key只查找一次
+            * @param out 输出数组，至少有n个元素的空间
+            * @return 实际拉取的个数，不足n个的部分计为未命中
+            */
+            size_t pull_n(key_t id, TObj** out, size_t n) {
+                if (0 == n || NULL == out) {
+                    return 0;
+                }
+
+                size_t ret = 0;
+                size_t total_bytes = 0;
+                typename cat_map_type::iterator iter = data_.find(id);
+                if (iter != data_.end() && iter->second) {
+                    TAction act;
+                    list_type& ls = *iter->second;
+                    // 拉取node, FILO
+                    while (ret < n && !ls.cache_.empty()) {
+                        typename list_type::wrapper& obj_wrapper = ls.cache_.front();
+                        out[ret++] = obj_wrapper.object;
+                        total_bytes += obj_wrapper.bytes;
+#ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
+                        check_pushed_.erase(obj_wrapper.object);
+#endif
+                        ls.cache_.pop_front();
+
+                        act.pull(out[ret - 1]);
+                        act.reset(out[ret - 1]);
+                    }
+
+                    ls.byte_size_ -= total_bytes;
+                    item_count_ -= ret;
+                    byte_size_ -= total_bytes;
+                }
+
+                if (iter != data_.end() && (!iter->second || iter->second->empty())) {
+                    data_.erase(iter);
+                }
+
+                if (mgr_) {
+                    mgr_->item_count().sub(ret, util::lock::memory_order_relaxed);
+                    mgr_->byte_count().sub(total_bytes, util::lock::memory_order_relaxed);
+                    mgr_->add_stat(lru_pool_manager::stat_type_t::PULL_HIT, ret);
+                    mgr_->add_stat(lru_pool_manager::stat_type_t::PULL_MISS, n - ret);
+                }
+
+                return ret;
+            }
+
             void clear() {
                 for (typename cat_map_type::iterator iter = data_.begin(); iter != data_.end();) {
                     typename cat_map_type::iterator checked_it = iter++;
@@ -579,38 +1736,56 @@ namespace util {
                 data_.clear();
             }
 
-            bool empty() const {
-                if (data_.empty()) {
-                    return true;
-                }
+            inline bool empty() const {
+                return 0 == item_count_;
+            }
 
-                for (typename cat_map_type::const_iterator iter = data_.begin(); iter != data_.end(); ++iter) {
-                    if (iter->second && !iter->second->empty()) {
-                        return false;
-                    }
+            inline size_t size() const {
+                return item_count_;
+            }
+
+            /**
+            * @brief 获取某个key缓存的对象个数
+            */
+            size_t size(const key_t& id) const {
+                typename cat_map_type::const_iterator iter = data_.find(id);
+                if (iter == data_.end() || !iter->second) {
+                    return 0;
                 }
 
-                return true;
+                return iter->second->size();
             }
 
-            // high cost, do not use it frequently 
-            size_t size() const {
-                size_t ret = 0;
-                for (typename cat_map_type::const_iterator iter = data_.begin(); iter != data_.end(); ++iter) {
-                    if (iter->second) {
-                        ret += iter->second->size();
-                    }
-                }
+            /**
+            * @brief 获取缓存的总字节数，由TAction::size(TObj*)统计
+            */
+            inline size_t byte_size() const {
+                return byte_size_;
+            }
 
-                return ret;
+        private:
+            void commit_push_n(list_type& ls, uint64_t first_id, size_t count, size_t bytes, uint64_t push_time) {
+                ls.byte_size_ += bytes;
+                item_count_ += count;
+                byte_size_ += bytes;
+
+                if (mgr_) {
+                    mgr_->item_count().add(count, util::lock::memory_order_relaxed);
+                    mgr_->byte_count().add(bytes, util::lock::memory_order_relaxed);
+                    mgr_->push_check_list(first_id, ls.mgr_handle_, push_time, static_cast<uint32_t>(count));
+                }
             }
 
         private:
+            // 必须在data_之前声明，保证所有list析构后再释放节点内存
+            typename list_type::allocator_type node_alloc_;
             cat_map_type data_;
             lru_pool_manager::ptr_t mgr_;
             util::lock::seq_alloc_u64 push_id_alloc_;
+            size_t item_count_;
+            size_t byte_size_;
 #ifdef _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
-            std::set<value_type*> check_pushed_;
+            detail::lru_pointer_set<value_type> check_pushed_;
 #endif
         };
     }
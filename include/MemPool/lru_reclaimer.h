@@ -0,0 +1,213 @@
+/**
+ * @file lru_reclaimer.h
+ * @brief lru对象池的后台回收器<br />
+ * Licensed under the MIT licenses.
+ *
+ * @note lru_pool_manager设置回收器后，被回收的对象通过无锁队列交给回收线程执行TAction::gc，业务线程不再承担释放的开销
+ * @note 队列满时退化为在调用线程回收，可以通过统计数据里的inline_count观察背压
+ *
+ * @version 1.0
+ * @author owent
+ * @date 2016-06-03
+ *
+ * @history
+ *     2016-06-07: 队列改用util::ds::mpmc_ring_queue
+ *
+ */
+
+#ifndef _UTIL_MEMPOOL_LRURECLAIMER_H_
+#define _UTIL_MEMPOOL_LRURECLAIMER_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "std/smart_ptr.h"
+
+#include "Lock/seq_alloc.h"
+#include "DataStructure/mpmc_ring_queue.h"
+
+#include "lru_object_pool.h"
+
+namespace util {
+    namespace mempool {
+        /**
+        * @brief 后台回收器，一个回收线程可以被多个lru_pool_manager共享
+        * @note 析构或stop时会先回收队列里剩余的所有对象
+        */
+        class lru_reclaimer : public lru_reclaimer_base {
+        public:
+            typedef std::shared_ptr<lru_reclaimer> ptr_t;
+
+            /**
+            * @brief 统计数据快照
+            */
+            struct stat_t {
+                uint64_t push_count;        // 进入队列的对象数
+                uint64_t reclaim_count;     // 回收线程已回收的对象数
+                uint64_t inline_count;      // 队列满或未运行时退回调用线程回收的次数
+                size_t depth;               // 当前队列长度
+                size_t max_depth;           // 队列长度的历史最大值
+                size_t capacity;            // 队列容量
+            };
+
+        private:
+            struct item_t {
+                reclaim_fn_t fn;
+                void* obj;
+            };
+
+            lru_reclaimer(size_t capacity) : queue_(capacity), idle_sleep_us_(1000) {
+                running_.store(false);
+                stop_.store(false);
+                push_count_.set(0);
+                reclaim_count_.set(0);
+                inline_count_.set(0);
+                max_depth_.store(0);
+            }
+
+            lru_reclaimer(const lru_reclaimer&);
+            lru_reclaimer& operator=(const lru_reclaimer&);
+
+        public:
+            /**
+            * @brief 创建回收器
+            * @param capacity 队列容量，会向上取整到2的幂
+            */
+            static ptr_t create(size_t capacity = 4096) {
+                return ptr_t(new lru_reclaimer(capacity));
+            }
+
+            virtual ~lru_reclaimer() {
+                stop();
+            }
+
+            /**
+            * @brief 启动回收线程
+            * @return 0或错误码
+            */
+            int start() {
+                if (running_.load()) {
+                    return -1;
+                }
+
+                stop_.store(false);
+                running_.store(true);
+                thread_ = std::thread(&lru_reclaimer::run, this);
+                return 0;
+            }
+
+            /**
+            * @brief 停止回收线程并回收队列里剩余的对象
+            * @note 调用前应该保证不再有线程调用push（比如先把管理器的回收器置空）
+            */
+            void stop() {
+                if (running_.load()) {
+                    stop_.store(true);
+                    if (thread_.joinable()) {
+                        thread_.join();
+                    }
+                    running_.store(false);
+                }
+
+                drain(0);
+            }
+
+            inline bool is_running() const { return running_.load(); }
+
+            /**
+            * @brief 队列为空时回收线程的休眠时间（微秒），默认1000
+            * @note 需要在start之前设置
+            */
+            inline void set_idle_sleep(uint32_t us) { idle_sleep_us_ = us; }
+            inline uint32_t get_idle_sleep() const { return idle_sleep_us_; }
+
+            virtual bool push(reclaim_fn_t fn, void* obj) {
+                if (!running_.load(std::memory_order_relaxed) || stop_.load(std::memory_order_relaxed)) {
+                    inline_count_.inc();
+                    return false;
+                }
+
+                item_t item;
+                item.fn = fn;
+                item.obj = obj;
+                if (!queue_.try_push(item)) {
+                    inline_count_.inc();
+                    return false;
+                }
+
+                push_count_.inc();
+                size_t depth = queue_.size();
+                // 近似的最大值，不需要严格
+                if (depth > max_depth_.load(std::memory_order_relaxed)) {
+                    max_depth_.store(depth, std::memory_order_relaxed);
+                }
+                return true;
+            }
+
+            /**
+            * @brief 在当前线程回收队列里的对象
+            * @note 只能在回收线程未运行时调用，否则会和回收线程同时消费
+            * @param max_count 最多回收的个数，0表示不限
+            * @return 回收的个数
+            */
+            size_t drain(size_t max_count) {
+                size_t ret = 0;
+                item_t item;
+                while ((0 == max_count || ret < max_count) && queue_.try_pop(item)) {
+                    item.fn(item.obj);
+                    ++ret;
+                }
+
+                if (ret > 0) {
+                    reclaim_count_.add(ret, util::lock::memory_order_relaxed);
+                }
+                return ret;
+            }
+
+            /**
+            * @brief 获取统计数据快照，可以在其他线程调用
+            */
+            stat_t get_stat() const {
+                stat_t ret;
+                ret.push_count = push_count_.get();
+                ret.reclaim_count = reclaim_count_.get(util::lock::memory_order_relaxed);
+                ret.inline_count = inline_count_.get();
+                ret.depth = queue_.size();
+                ret.max_depth = max_depth_.load(std::memory_order_relaxed);
+                ret.capacity = queue_.capacity();
+                return ret;
+            }
+
+        private:
+            void run() {
+                while (!stop_.load(std::memory_order_acquire)) {
+                    if (0 == drain(queue_.capacity())) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(idle_sleep_us_));
+                    }
+                }
+
+                // 停止后生产者可能还有正在写入的槽位，把已就绪的全部回收
+                drain(0);
+            }
+
+        private:
+            util::ds::mpmc_ring_queue<item_t> queue_;
+            std::thread thread_;
+            std::atomic<bool> running_;
+            std::atomic<bool> stop_;
+            uint32_t idle_sleep_us_;
+
+            // 多个生产者线程写入的计数按线程分片
+            util::lock::sharded_seq_alloc_u64 push_count_;
+            util::lock::padded_seq_alloc_u64 reclaim_count_;
+            util::lock::sharded_seq_alloc_u64 inline_count_;
+            std::atomic<size_t> max_depth_;
+        };
+    }
+}
+
+#endif /* _UTIL_MEMPOOL_LRURECLAIMER_H_ */
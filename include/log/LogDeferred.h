@@ -0,0 +1,158 @@
+﻿/**
+ * @file LogDeferred.h
+ * @brief 延迟格式化日志（WCLOGDEFER*）的参数编码和解码
+ * Licensed under the MIT licenses.
+ *
+ * @note 调用线程只把参数按值编码进日志记录，格式化在异步写线程上进行，没有开启异步模式时在调用线程立即格式化
+ * @note 参数只支持算术类型、枚举、指针和C字符串(char*、signed char*、unsigned char*，调用时拷贝内容)，其他类型编译期报错
+ * @note wchar_t*、char16_t*和char32_t*不会拷贝内容，写线程输出时可能已经失效，所以也会编译期报错
+ * @note 格式串只保存指针，必须是字符串常量
+ * @note 编码后的参数放在队列槽位内置的空间里(LOG_WRAPPER_ASYNC_RECORD_INLINE_SIZE)，放不下时才malloc，由写线程输出后释放
+ * @note 记录只存在于进程内存中，没有提供离线解码工具
+ * @note 使用了 c++11的变长模板参数
+ *
+ * @version 1.0
+ * @author OWenT
+ * @date 2016-06-08
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace util {
+    namespace log {
+        namespace detail {
+            // 宽字符串的指针，按值保存的话写线程读到的可能是已经释放的内存
+            template<typename T>
+            struct log_deferred_is_wide_string {
+                typedef typename std::remove_cv<typename std::remove_pointer<T>::type>::type char_type;
+                static const bool value = std::is_pointer<T>::value && (std::is_same<char_type, wchar_t>::value ||
+                    std::is_same<char_type, char16_t>::value || std::is_same<char_type, char32_t>::value);
+            };
+
+            /**
+             * @brief 延迟格式化日志的参数编码
+             * @note 只支持算术类型、枚举和指针，参数按值直接拷贝；窄字符的C字符串按字符串拷贝内容
+             */
+            template<typename T>
+            struct log_deferred_arg {
+                static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                    "deferred log only support arithmetic, enum, pointer and C string arguments");
+                static_assert(!log_deferred_is_wide_string<T>::value,
+                    "deferred log do not support wide string arguments, use WCLOG* instead");
+
+                typedef T value_type;
+
+                static inline size_t size(const T&) { return sizeof(T); }
+
+                static inline unsigned char* write(unsigned char* data, const T& v) {
+                    memcpy(data, &v, sizeof(T));
+                    return data + sizeof(T);
+                }
+
+                static inline const unsigned char* read(const unsigned char* data, value_type& v) {
+                    memcpy(&v, data, sizeof(T));
+                    return data + sizeof(T);
+                }
+            };
+
+            struct log_deferred_string_arg {
+                typedef const char* value_type;
+
+                static inline size_t size(const void* v) { return (NULL == v ? 0 : strlen(static_cast<const char*>(v))) + 1; }
+
+                static inline unsigned char* write(unsigned char* data, const void* v) {
+                    size_t len = size(v);
+                    if (NULL == v) {
+                        data[0] = 0;
+                    } else {
+                        memcpy(data, v, len);
+                    }
+                    return data + len;
+                }
+
+                // 直接指向记录里的内容
+                static inline const unsigned char* read(const unsigned char* data, value_type& v) {
+                    v = reinterpret_cast<const char*>(data);
+                    return data + strlen(v) + 1;
+                }
+            };
+
+            template<>
+            struct log_deferred_arg<const char*> : public log_deferred_string_arg {};
+
+            template<>
+            struct log_deferred_arg<char*> : public log_deferred_string_arg {};
+
+            template<>
+            struct log_deferred_arg<const unsigned char*> : public log_deferred_string_arg {};
+
+            template<>
+            struct log_deferred_arg<unsigned char*> : public log_deferred_string_arg {};
+
+            template<>
+            struct log_deferred_arg<const signed char*> : public log_deferred_string_arg {};
+
+            template<>
+            struct log_deferred_arg<signed char*> : public log_deferred_string_arg {};
+
+            inline size_t log_deferred_args_size() { return 0; }
+
+            template<typename T, typename... TRest>
+            inline size_t log_deferred_args_size(const T& v, const TRest&... rest) {
+                return log_deferred_arg<T>::size(v) + log_deferred_args_size(rest...);
+            }
+
+            inline unsigned char* log_deferred_args_write(unsigned char* data) { return data; }
+
+            template<typename T, typename... TRest>
+            inline unsigned char* log_deferred_args_write(unsigned char* data, const T& v, const TRest&... rest) {
+                return log_deferred_args_write(log_deferred_arg<T>::write(data, v), rest...);
+            }
+
+            /**
+             * @brief 按编码时的参数类型依次解码，最后调用snprintf
+             */
+            template<typename... TArgs>
+            struct log_deferred_formatter;
+
+            template<>
+            struct log_deferred_formatter<> {
+                template<typename... TDecoded>
+                static int format(char* out, size_t size, const char* fmt, const unsigned char*, TDecoded... decoded) {
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif
+                    return snprintf(out, size, fmt, decoded...);
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+                }
+
+                static int call(char* out, size_t size, const char* fmt, const unsigned char* data) {
+                    return format(out, size, fmt, data);
+                }
+            };
+
+            template<typename T, typename... TRest>
+            struct log_deferred_formatter<T, TRest...> {
+                template<typename... TDecoded>
+                static int format(char* out, size_t size, const char* fmt, const unsigned char* data, TDecoded... decoded) {
+                    typename log_deferred_arg<T>::value_type v;
+                    data = log_deferred_arg<T>::read(data, v);
+                    return log_deferred_formatter<TRest...>::format(out, size, fmt, data, decoded..., v);
+                }
+
+                static int call(char* out, size_t size, const char* fmt, const unsigned char* data) {
+                    return format(out, size, fmt, data);
+                }
+            };
+        }
+    }
+}
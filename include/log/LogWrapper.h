@@ -2,15 +2,22 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cstdarg>
 #include <stdint.h>
 #include <string>
 #include <inttypes.h>
 #include <ctime>
 #include <list>
+#include <atomic>
+#include <thread>
 #include "std/functional.h"
 #include "std/smart_ptr.h"
 
 #include "DesignPattern/Singleton.h"
+#include "DataStructure/mpmc_ring_queue.h"
+#include "Lock/seq_alloc.h"
+
+#include "log/LogDeferred.h"
 
 #ifndef LOG_WRAPPER_MAX_SIZE_PER_LINE
 #define LOG_WRAPPER_MAX_SIZE_PER_LINE 65536
@@ -20,6 +27,27 @@
 #define LOG_WRAPPER_CATEGORIZE_SIZE 4
 #endif
 
+/**
+ * @brief 编译期的最低日志级别，级别更低的日志语句会被编译器整个去掉
+ * @note 比如release版本定义为4(LOG_LW_INFO)可以去掉所有Notice和Debug日志
+ */
+#ifndef LOG_WRAPPER_COMPILE_LEVEL
+#define LOG_WRAPPER_COMPILE_LEVEL util::log::LogWrapper::level_t::LOG_LW_DEBUG
+#endif
+
+/**
+ * @brief 异步模式下每条日志记录内置的内容空间，内容放得下时不需要分配内存
+ * @note 队列的每个槽位都是一条完整的记录，占用内存约为队列长度*(这个值+80)字节
+ */
+#ifndef LOG_WRAPPER_ASYNC_RECORD_INLINE_SIZE
+#define LOG_WRAPPER_ASYNC_RECORD_INLINE_SIZE 176
+#endif
+
+// 异步模式下写线程每批最多处理的日志条数
+#ifndef LOG_WRAPPER_ASYNC_BATCH_SIZE
+#define LOG_WRAPPER_ASYNC_BATCH_SIZE 64
+#endif
+
 namespace util {
     namespace log {
         class LogWrapper : public Singleton<LogWrapper>
@@ -44,6 +72,18 @@ namespace util {
                 };
             };
 
+            /**
+             * @brief 异步模式下队列满时的处理方式
+             * @note 输出里再写的日志总是在写线程上同步输出，不进入队列
+             */
+            struct overflow_policy_t {
+                enum type {
+                    BLOCK = 0,      // 等待写线程腾出空间
+                    DROP_OLDEST,    // 丢弃队列里最早的一条
+                    DROP_NEWEST,    // 丢弃当前这一条
+                };
+            };
+
             typedef std::function<void(level_t::type level_id, const char* level, const char* content)> log_handler_t;
             typedef struct {
                 level_t::type level_min;
@@ -51,6 +91,45 @@ namespace util {
                 log_handler_t handle;
             } log_router_t;
 
+        private:
+            typedef int (*deferred_formatter_t)(char* out, size_t size, const char* fmt, const unsigned char* args);
+
+            /**
+             * @brief 异步模式下的一条日志，按值保存在队列的槽位里
+             * @note formatter为空时内容是格式化好的日志；否则内容是编码后的参数，由写线程格式化
+             * @note 内容放在内置的data里，放不下时才malloc，由写线程输出后释放
+             * @note level、file_path、func_name和fmt只保存指针，必须是字符串常量
+             */
+            struct async_record_t {
+                level_t::type level_id;
+                const char* level;
+                size_t length;
+
+                deferred_formatter_t formatter;
+                const char* file_path;
+                uint32_t line_number;
+                const char* func_name;
+                const char* fmt;
+                time_t log_time;
+                uint32_t log_usec;
+
+                char* heap;
+                char data[LOG_WRAPPER_ASYNC_RECORD_INLINE_SIZE];
+
+                inline char* content() { return NULL == heap ? data : heap; }
+
+                // 准备content_size字节的内容空间，分配失败时返回false
+                inline bool reserve(size_t content_size) {
+                    heap = content_size <= sizeof(data) ? NULL : static_cast<char*>(malloc(content_size));
+                    return content_size <= sizeof(data) || NULL != heap;
+                }
+
+                inline void release() {
+                    free(heap);
+                    heap = NULL;
+                }
+            };
+
         protected:
             LogWrapper();
             virtual ~LogWrapper();
@@ -59,10 +138,19 @@ namespace util {
             // 初始化
             int32_t init(level_t::type level = level_t::LOG_LW_DEBUG);
 
+            /**
+             * @brief 读取时钟并更新日志时间，当前线程的缓存在秒数变化时才用localtime_r重新计算日期
+             * @note 时间读取自CLOCK_REALTIME_COARSE（不支持时使用std::chrono::system_clock），精确到微秒
+             * @note 时间是所有线程共享的；各线程缓存日期，共享时间的秒数变化时才重新计算
+             * @note 关闭自动更新时，外部调用update()对所有线程生效
+             */
             static void update();
 
-            static inline time_t getLogTime() { return log_time_cache_sec_; }
-            static inline const tm* getLogTm() { return log_time_cache_sec_p_; }
+            // 最近一次update()的时间，从来没有更新过时会先读取一次时钟
+            static time_t getLogTime();
+            // 缓存时间秒以下的部分(微秒)
+            static uint32_t getLogTimeUsec();
+            static const tm* getLogTm();
 
             void log(level_t::type level_id, const char* level, const char* file_path, uint32_t line_number, const char* func_name, 
 #ifdef _MSC_VER
@@ -74,6 +162,45 @@ namespace util {
                 const char* fmt, ...);
 #endif
 
+            /**
+             * @brief 延迟格式化的日志，调用线程只记录格式串指针、参数和时间，格式化在写线程上进行
+             * @note fmt必须是字符串常量；参数只支持算术类型、枚举、指针和C字符串（会拷贝内容）
+             * @note 没有开启异步模式时在调用线程立即格式化输出
+             */
+            template<typename... TArgs>
+            void logDeferred(level_t::type level_id, const char* level, const char* file_path, uint32_t line_number,
+                             const char* func_name, const char* fmt, TArgs... args) {
+                if (log_handlers_.empty()) {
+                    return;
+                }
+
+                async_record_t record;
+                if (!record.reserve(detail::log_deferred_args_size(args...))) {
+                    return;
+                }
+
+                detail::log_deferred_args_write(reinterpret_cast<unsigned char*>(record.content()), args...);
+                record.level_id = level_id;
+                record.level = level;
+                record.length = 0;
+                record.formatter = &detail::log_deferred_formatter<TArgs...>::call;
+                record.file_path = file_path;
+                record.line_number = line_number;
+                record.func_name = func_name;
+                record.fmt = fmt;
+                commitDeferred(record);
+            }
+
+            // 只用于日志宏的格式检查，不会被调用
+            static inline void checkFormat(
+#ifdef _MSC_VER
+                _In_z_ _Printf_format_string_ const char*, ...) {}
+#elif (defined(__clang__) && __clang_major__ >= 3) || (defined(__GNUC__) && __GNUC__ >= 4)
+                const char*, ...) __attribute__((format(printf, 1, 2))) {}
+#else
+                const char*, ...) {}
+#endif
+
             // 一般日志级别检查
             inline bool check(level_t::type level) {
                 return !IsInstanceDestroyed() && log_level_ >= level;
@@ -83,6 +210,37 @@ namespace util {
 
             void addLogHandle(log_handler_t h, level_t::type level_min = level_t::LOG_LW_FATAL, level_t::type level_max = level_t::LOG_LW_DEBUG);
 
+            // 移除所有输出，异步模式下需要先stopAsync
+            inline void clearLogHandle() { log_handlers_.clear(); }
+
+            /**
+             * @brief 开启异步模式：日志在调用线程格式化后放入无锁队列，由单独的写线程批量交给输出
+             * @note 输出只会在写线程上调用；需要在没有其他线程写日志、并且添加完输出之后调用
+             * @param queue_size 队列长度，会向上取整到2的幂
+             * @param policy 队列满时的处理方式
+             * @return 0或错误码
+             */
+            int32_t startAsync(size_t queue_size = 4096, overflow_policy_t::type policy = overflow_policy_t::BLOCK);
+
+            /**
+             * @brief 停止异步模式，写完队列里剩余的日志后返回，之后的日志恢复为同步输出
+             * @note 在输出（写线程）里调用时直接返回
+             */
+            void stopAsync();
+
+            /**
+             * @brief 等待调用之前写入的日志全部交给输出（或被丢弃）
+             * @note 同步模式下或者在输出（写线程）里调用时直接返回
+             */
+            void flush();
+
+            inline bool isAsync() const { return async_running_.load(std::memory_order_acquire); }
+
+            inline overflow_policy_t::type getOverflowPolicy() const { return async_policy_; }
+
+            // 异步模式下因为队列满被丢弃的日志条数
+            inline uint64_t getAsyncDropCount() const { return async_drop_count_.get(util::lock::memory_order_relaxed); }
+
             inline void setLevel(level_t::type l) { log_level_ = l; }
 
             inline level_t::type getLevel() const { return log_level_; }
@@ -119,18 +277,62 @@ namespace util {
                 return enable_print_time_;
             }
 
-            inline void setEnablePrintTime(const std::string& enable_print_time) {
-                enable_print_time_ = enable_print_time;
-            }
+            /**
+             * @brief 设置时间的输出格式，为空时不输出时间
+             * @note 除strftime的格式外，支持用%3N输出毫秒、%6N输出微秒（只支持一处），默认格式不带秒以下的部分
+             */
+            void setEnablePrintTime(const std::string& enable_print_time);
 
             // TODO 白名单及用户指定日志输出以后有需要再说
 
-            static LogWrapper* getLogCat(uint32_t cats = categorize_t::DEFAULT);
+            /**
+             * @brief 获取分类日志对象
+             * @note 初始化之后只读一个全局指针，可以内联到每条日志语句里；第一次调用时才构造所有分类
+             */
+            static inline LogWrapper* getLogCat(uint32_t cats = categorize_t::DEFAULT) {
+                LogWrapper* all_logger = all_logger_.load(std::memory_order_acquire);
+                if (NULL != all_logger && cats < categorize_t::MAX) {
+                    return all_logger + cats;
+                }
+
+                return initLogCat(cats);
+            }
+
+        private:
+            static LogWrapper* initLogCat(uint32_t cats);
+
+            static const tm* getLogTmAt(time_t t);
+
+            // 当前线程的缓存同步到共享时间
+            static const tm* syncLogTime();
+
+            static size_t terminate(char* log_buffer, size_t log_buffer_size, int start_index);
+
+            int formatPrefix(char* log_buffer, size_t log_buffer_size, const char* level, const char* file_path,
+                             uint32_t line_number, const char* func_name, const tm* log_tm, uint32_t log_usec);
+
+            void writeDeferred(char* log_buffer, size_t log_buffer_size, async_record_t& record);
+
+            void commitDeferred(async_record_t& record);
+
+            void writeLog(char* log_buffer, size_t log_buffer_size, level_t::type level_id, const char* level,
+                        const char* file_path, uint32_t line_number, const char* func_name, const char* fmt, va_list va_args);
+
+            void dispatch(level_t::type level_id, const char* level, const char* content);
+
+            // 写线程已停止时返回false，这时record的内容仍由调用者释放
+            bool pushAsync(async_record_t& record);
+
+            // 当前线程是否是这个LogWrapper的异步写线程
+            bool isAsyncWriter() const;
+
+            void asyncWriterMain();
+
+            size_t asyncDrain(size_t max_count);
+
         private:
             level_t::type log_level_;
             bool auto_update_time_;
-            static time_t log_time_cache_sec_;
-            static tm* log_time_cache_sec_p_;
             std::list<log_router_t> log_handlers_;
 
             bool enable_print_file_location_;
@@ -139,8 +341,25 @@ namespace util {
             bool enable_print_function_name_;
             bool enable_print_log_type_;
             std::string enable_print_time_;
+            std::string print_time_prefix_;     // %3N或%6N之前的部分
+            std::string print_time_suffix_;     // %3N或%6N之后的部分
+            int print_time_subsec_digits_;      // 秒以下输出的位数，0表示不输出
+
+            // 异步模式
+            std::unique_ptr<util::ds::mpmc_ring_queue<async_record_t> > async_queue_;
+            std::thread async_thread_;
+            overflow_policy_t::type async_policy_;
+            std::atomic<bool> async_running_;
+            std::atomic<bool> async_stop_;
+            // 写入端的计数按线程分片，写线程的计数独占缓存行，写入线程之间、写入线程和写线程之间都不竞争同一个缓存行
+            util::lock::sharded_seq_alloc_i64 async_producers_;     // 正在写入队列的线程数
+            util::lock::sharded_seq_alloc_u64 async_push_count_;    // 已写入队列的条数
+            util::lock::padded_seq_alloc_u64 async_done_count_;     // 已输出或被丢弃的条数（只统计写入过队列的）
+            util::lock::padded_seq_alloc_u64 async_drop_count_;
 
             static bool destroyed_;
+            // 构造完成的分类日志对象数组，析构时清空
+            static std::atomic<LogWrapper*> all_logger_;
         };
     }
 }
@@ -154,12 +373,18 @@ namespace util {
 
 #define WLOG_GETCAT(cat) util::log::LogWrapper::getLogCat(cat)
 
+// 常量表达式，低于LOG_WRAPPER_COMPILE_LEVEL的日志语句整个被编译器去掉，但参数和格式仍然会被检查
+#define WLOG_COMPILE_CHECK(lv) (static_cast<int>(lv) <= static_cast<int>(LOG_WRAPPER_COMPILE_LEVEL))
+
 // 按分类日志输出工具
 #ifdef _MSC_VER
 
 #define WCLOGDEFLV(lv, lv_name, cat, ...) \
-            if (NULL != WDTLOGGETCAT(cat) && WDTLOGGETCAT(cat)->check(lv))\
-                WDTLOGGETCAT(cat)->log(WDTLOGFILENF(lv, lv_name), __VA_ARGS__);
+            if (WLOG_COMPILE_CHECK(lv)) { \
+                util::log::LogWrapper* wlog_cat_ptr = WDTLOGGETCAT(cat); \
+                if (NULL != wlog_cat_ptr && wlog_cat_ptr->check(lv)) \
+                    wlog_cat_ptr->log(WDTLOGFILENF(lv, lv_name), __VA_ARGS__); \
+            }
 
 #define WCLOGDEBUG(cat, ...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_DEBUG, "Debug", cat, __VA_ARGS__)
 #define WCLOGNOTICE(cat, ...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_NOTICE, "Notice", cat, __VA_ARGS__)
@@ -168,11 +393,30 @@ namespace util {
 #define WCLOGERROR(cat, ...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_ERROR, "Error", cat, __VA_ARGS__)
 #define WCLOGFATAL(cat, ...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_FATAL, "Fatal", cat, __VA_ARGS__)
 
+#define WCLOGDEFERLV(lv, lv_name, cat, ...) \
+            if (WLOG_COMPILE_CHECK(lv)) { \
+                util::log::LogWrapper* wlog_cat_ptr = WDTLOGGETCAT(cat); \
+                if (false) util::log::LogWrapper::checkFormat(__VA_ARGS__); \
+                if (NULL != wlog_cat_ptr && wlog_cat_ptr->check(lv)) \
+                    wlog_cat_ptr->logDeferred(WDTLOGFILENF(lv, lv_name), __VA_ARGS__); \
+            }
+
+// 延迟格式化的日志输出工具，参数限制见LogWrapper::logDeferred
+#define WCLOGDEFERDEBUG(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_DEBUG, "Debug", cat, __VA_ARGS__)
+#define WCLOGDEFERNOTICE(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_NOTICE, "Notice", cat, __VA_ARGS__)
+#define WCLOGDEFERINFO(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_INFO, "Info", cat, __VA_ARGS__)
+#define WCLOGDEFERWARNING(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_WARNING, "Warning", cat, __VA_ARGS__)
+#define WCLOGDEFERERROR(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_ERROR, "Error", cat, __VA_ARGS__)
+#define WCLOGDEFERFATAL(cat, ...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_FATAL, "Fatal", cat, __VA_ARGS__)
+
 #else
 
 #define WCLOGDEFLV(lv, lv_name, cat, args...) \
-            if (NULL != WDTLOGGETCAT(cat) && WDTLOGGETCAT(cat)->check(lv))\
-                WDTLOGGETCAT(cat)->log(WDTLOGFILENF(lv, lv_name), ##args);
+            if (WLOG_COMPILE_CHECK(lv)) { \
+                util::log::LogWrapper* wlog_cat_ptr = WDTLOGGETCAT(cat); \
+                if (NULL != wlog_cat_ptr && wlog_cat_ptr->check(lv)) \
+                    wlog_cat_ptr->log(WDTLOGFILENF(lv, lv_name), ##args); \
+            }
 
 #define WCLOGDEBUG(...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_DEBUG, "Debug", __VA_ARGS__)
 #define WCLOGNOTICE(...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_NOTICE, "Notice", __VA_ARGS__)
@@ -181,6 +425,22 @@ namespace util {
 #define WCLOGERROR(...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_ERROR, "Error", __VA_ARGS__)
 #define WCLOGFATAL(...) WCLOGDEFLV(util::log::LogWrapper::level_t::LOG_LW_FATAL, "Fatal", __VA_ARGS__)
 
+#define WCLOGDEFERLV(lv, lv_name, cat, args...) \
+            if (WLOG_COMPILE_CHECK(lv)) { \
+                util::log::LogWrapper* wlog_cat_ptr = WDTLOGGETCAT(cat); \
+                if (false) util::log::LogWrapper::checkFormat(args); \
+                if (NULL != wlog_cat_ptr && wlog_cat_ptr->check(lv)) \
+                    wlog_cat_ptr->logDeferred(WDTLOGFILENF(lv, lv_name), ##args); \
+            }
+
+// 延迟格式化的日志输出工具，参数限制见LogWrapper::logDeferred
+#define WCLOGDEFERDEBUG(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_DEBUG, "Debug", __VA_ARGS__)
+#define WCLOGDEFERNOTICE(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_NOTICE, "Notice", __VA_ARGS__)
+#define WCLOGDEFERINFO(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_INFO, "Info", __VA_ARGS__)
+#define WCLOGDEFERWARNING(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_WARNING, "Warning", __VA_ARGS__)
+#define WCLOGDEFERERROR(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_ERROR, "Error", __VA_ARGS__)
+#define WCLOGDEFERFATAL(...) WCLOGDEFERLV(util::log::LogWrapper::level_t::LOG_LW_FATAL, "Fatal", __VA_ARGS__)
+
 #endif
 
 // 默认日志输出工具
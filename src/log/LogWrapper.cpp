@@ -1,27 +1,164 @@
 ﻿#include <cstdio>
 #include <cstring>
 #include <stdarg.h>
+#include <time.h>
+#include <chrono>
+#include <cstdlib>
 #include "log/LogWrapper.h"
 
+#include "std/thread.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// 异步写线程空闲时的休眠时间
+#define LOG_WRAPPER_ASYNC_IDLE_SLEEP_US 200
+
 namespace util {
     namespace log {
 
+        namespace detail {
+            struct log_time_cache_t {
+                time_t sec;
+                uint32_t usec;
+                tm tm_val;
+                bool inited;
+            };
+
+            // update()发布的时间(微秒)，0表示还没有更新过
+            static std::atomic<int64_t> g_log_time_us(0);
+
+            // 各线程缓存共享时间对应的日期，共享时间的秒数变化时才重新计算；格式化缓冲区也是线程独立的
+#if defined(THREAD_TLS_ENABLED)
+            static THREAD_TLS log_time_cache_t g_log_time_cache;
+            // 第一次写日志时才分配，不写日志的线程不占用这部分内存
+            static THREAD_TLS char* g_log_buffer = NULL;
+            static THREAD_TLS bool g_log_buffer_used = false;
+            // 当前线程是哪个LogWrapper的异步写线程
+            static THREAD_TLS const LogWrapper* g_log_async_writer = NULL;
+#else
+            static log_time_cache_t g_log_time_cache;
+#endif
+
+            /**
+             * @brief 读取当前时间(秒+微秒)
+             * @note Linux下默认使用CLOCK_REALTIME_COARSE，不需要读硬件时钟，精度是一个时钟节拍(一般1-4毫秒)
+             * @note 需要更高精度时定义LOG_WRAPPER_DISABLE_COARSE_CLOCK
+             */
+            static inline void get_wall_clock(time_t& sec, uint32_t& usec) {
+#if defined(CLOCK_REALTIME_COARSE) && !defined(LOG_WRAPPER_DISABLE_COARSE_CLOCK)
+                timespec ts;
+                if (0 == clock_gettime(CLOCK_REALTIME_COARSE, &ts)) {
+                    sec = ts.tv_sec;
+                    usec = static_cast<uint32_t>(ts.tv_nsec / 1000);
+                    return;
+                }
+#endif
+                int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                sec = static_cast<time_t>(now_us / 1000000);
+                usec = static_cast<uint32_t>(now_us % 1000000);
+            }
+
+#if defined(THREAD_TLS_ENABLED)
+            // THREAD_TLS不一定支持析构，线程退出时通过FLS/pthread key释放格式化缓冲区
+#if defined(_WIN32)
+            static VOID WINAPI free_log_buffer(PVOID buf) { free(buf); }
+
+            static bool register_log_buffer(char* buf) {
+                static DWORD key = FlsAlloc(free_log_buffer);
+                return FLS_OUT_OF_INDEXES != key && FALSE != FlsSetValue(key, buf);
+            }
+#else
+            static pthread_key_t g_log_buffer_key;
+            static bool g_log_buffer_key_inited = false;
+
+            static void init_log_buffer_key() {
+                g_log_buffer_key_inited = (0 == pthread_key_create(&g_log_buffer_key, free));
+            }
+
+            static bool register_log_buffer(char* buf) {
+                static pthread_once_t once = PTHREAD_ONCE_INIT;
+                pthread_once(&once, init_log_buffer_key);
+                return g_log_buffer_key_inited && 0 == pthread_setspecific(g_log_buffer_key, buf);
+            }
+#endif
+
+            /**
+             * @brief 获取当前线程的格式化缓冲区，第一次调用时分配
+             * @return 缓冲区地址，分配失败时返回NULL
+             */
+            static char* get_log_buffer() {
+                if (NULL == g_log_buffer) {
+                    char* buf = static_cast<char*>(malloc(LOG_WRAPPER_MAX_SIZE_PER_LINE));
+                    if (NULL != buf && !register_log_buffer(buf)) {
+                        free(buf);
+                        buf = NULL;
+                    }
+                    g_log_buffer = buf;
+                }
+
+                return g_log_buffer;
+            }
+#endif
+        }
+
+/**
+ * @brief 使用当前线程的格式化缓冲区执行expr
+ * @note 输出里又写日志时不能复用外层正在使用的缓冲区，改用栈上的缓冲区；缓冲区分配失败时也使用栈上的缓冲区
+ */
+#if defined(THREAD_TLS_ENABLED)
+#define LOG_WRAPPER_WITH_BUFFER(buf, buf_size, expr) \
+            { \
+                char* tls_buf = detail::g_log_buffer_used ? NULL : detail::get_log_buffer(); \
+                if (NULL == tls_buf) { \
+                    char buf[LOG_WRAPPER_MAX_SIZE_PER_LINE]; \
+                    const size_t buf_size = sizeof(buf); \
+                    expr; \
+                } else { \
+                    detail::g_log_buffer_used = true; \
+                    char* buf = tls_buf; \
+                    const size_t buf_size = LOG_WRAPPER_MAX_SIZE_PER_LINE; \
+                    expr; \
+                    detail::g_log_buffer_used = false; \
+                } \
+            }
+#else
+#define LOG_WRAPPER_WITH_BUFFER(buf, buf_size, expr) \
+            { \
+                char buf[LOG_WRAPPER_MAX_SIZE_PER_LINE]; \
+                const size_t buf_size = sizeof(buf); \
+                expr; \
+            }
+#endif
+
         bool LogWrapper::destroyed_ = false;
-        time_t LogWrapper::log_time_cache_sec_ = 0;
-        tm* LogWrapper::log_time_cache_sec_p_;
+        std::atomic<LogWrapper*> LogWrapper::all_logger_(NULL);
 
         LogWrapper::LogWrapper() :
-            log_level_(level_t::LOG_LW_DISABLED) {
+            log_level_(level_t::LOG_LW_DISABLED), async_policy_(overflow_policy_t::BLOCK) {
+            async_running_.store(false);
+            async_stop_.store(false);
+            async_producers_.set(0);
+            async_push_count_.set(0);
+            async_done_count_.set(0);
+            async_drop_count_.set(0);
+
             auto_update_time_ = true;
             update();
 
             enable_print_file_location_ = true;
             enable_print_function_name_ = true;
             enable_print_log_type_ = true;
-            enable_print_time_ = "[%Y-%m-%d %H:%M:%S]";
+            setEnablePrintTime("[%Y-%m-%d %H:%M:%S]");
         }
 
         LogWrapper::~LogWrapper() {
+            stopAsync();
+            LogWrapper::all_logger_.store(NULL, std::memory_order_release);
             LogWrapper::destroyed_ = true;
 
             // 重置level，只要内存没释放，就还可以内存访问，但是不能写出日志
@@ -45,8 +182,67 @@ namespace util {
         }
 
         void LogWrapper::update() {
-            log_time_cache_sec_ = time(NULL);
-            log_time_cache_sec_p_ = localtime(&log_time_cache_sec_);
+            time_t sec;
+            uint32_t usec;
+            detail::get_wall_clock(sec, usec);
+
+            // 粗粒度时钟几毫秒才变化一次，值不变时不写，避免所有写日志的线程每次都写同一个缓存行
+            int64_t now_us = static_cast<int64_t>(sec) * 1000000 + usec;
+            if (now_us != detail::g_log_time_us.load(std::memory_order_relaxed)) {
+                detail::g_log_time_us.store(now_us, std::memory_order_release);
+            }
+            syncLogTime();
+        }
+
+        const tm* LogWrapper::syncLogTime() {
+            int64_t now_us = detail::g_log_time_us.load(std::memory_order_acquire);
+            if (0 == now_us) {
+                time_t sec;
+                uint32_t usec;
+                detail::get_wall_clock(sec, usec);
+                now_us = static_cast<int64_t>(sec) * 1000000 + usec;
+
+                // 其他线程已经更新过时以其他线程的为准
+                int64_t expected = 0;
+                if (!detail::g_log_time_us.compare_exchange_strong(expected, now_us, std::memory_order_acq_rel)) {
+                    now_us = expected;
+                }
+            }
+
+            const tm* ret = getLogTmAt(static_cast<time_t>(now_us / 1000000));
+            detail::g_log_time_cache.usec = static_cast<uint32_t>(now_us % 1000000);
+            return ret;
+        }
+
+        const tm* LogWrapper::getLogTmAt(time_t t) {
+            detail::log_time_cache_t& cache = detail::g_log_time_cache;
+            if (cache.inited && t == cache.sec) {
+                return &cache.tm_val;
+            }
+
+#if defined(_MSC_VER)
+            localtime_s(&cache.tm_val, &t);
+#else
+            localtime_r(&t, &cache.tm_val);
+#endif
+            cache.sec = t;
+            cache.usec = 0;
+            cache.inited = true;
+            return &cache.tm_val;
+        }
+
+        time_t LogWrapper::getLogTime() {
+            syncLogTime();
+            return detail::g_log_time_cache.sec;
+        }
+
+        uint32_t LogWrapper::getLogTimeUsec() {
+            syncLogTime();
+            return detail::g_log_time_cache.usec;
+        }
+
+        const tm* LogWrapper::getLogTm() {
+            return syncLogTime();
         }
 
         void LogWrapper::log(level_t::type level_id, const char* level, const char* file_path, uint32_t line_number,
@@ -55,60 +251,299 @@ namespace util {
                 update();
             }
 
-            char log_buffer[LOG_WRAPPER_MAX_SIZE_PER_LINE];
             if (!log_handlers_.empty()) {
-                // format => "[Log    DEBUG][2015-01-12 10:09:08.]
-                int start_index = 0;
+                va_list va_args;
+                va_start(va_args, fmt);
+                LOG_WRAPPER_WITH_BUFFER(log_buffer, log_buffer_size,
+                    writeLog(log_buffer, log_buffer_size, level_id, level, file_path, line_number, func_name, fmt, va_args));
+                va_end(va_args);
+            }
+        }
+
+        void LogWrapper::writeLog(char* log_buffer, size_t log_buffer_size, level_t::type level_id, const char* level,
+                                const char* file_path, uint32_t line_number, const char* func_name, const char* fmt, va_list va_args) {
+            const tm* log_tm = syncLogTime();
+            int start_index = formatPrefix(log_buffer, log_buffer_size, level, file_path, line_number, func_name, log_tm,
+                                           detail::g_log_time_cache.usec);
+            start_index += vsnprintf(&log_buffer[start_index], log_buffer_size - start_index, fmt, va_args);
+            size_t length = terminate(log_buffer, log_buffer_size, start_index);
+
+            // 异步模式下交给写线程，写线程已停止或者就在写线程上（输出里又写日志）时同步输出
+            if (async_running_.load(std::memory_order_acquire) && !isAsyncWriter()) {
+                async_record_t record;
+                if (record.reserve(length + 1)) {
+                    record.level_id = level_id;
+                    record.level = level;
+                    record.formatter = NULL;
+                    record.length = length;
+                    memcpy(record.content(), log_buffer, length + 1);
+                    if (pushAsync(record)) {
+                        return;
+                    }
+                    record.release();
+                }
+            }
+
+            dispatch(level_id, level, log_buffer);
+        }
+
+        void LogWrapper::writeDeferred(char* log_buffer, size_t log_buffer_size, async_record_t& record) {
+            int start_index = formatPrefix(log_buffer, log_buffer_size, record.level, record.file_path, record.line_number,
+                                           record.func_name, getLogTmAt(record.log_time), record.log_usec);
+            int res = record.formatter(&log_buffer[start_index], log_buffer_size - start_index, record.fmt,
+                                       reinterpret_cast<const unsigned char*>(record.content()));
+            start_index += res >= 0 ? res : 0;
+            terminate(log_buffer, log_buffer_size, start_index);
+
+            dispatch(record.level_id, record.level, log_buffer);
+        }
+
+        void LogWrapper::commitDeferred(async_record_t& record) {
+            detail::get_wall_clock(record.log_time, record.log_usec);
+
+            if (async_running_.load(std::memory_order_acquire) && !isAsyncWriter() && pushAsync(record)) {
+                return;
+            }
+
+            LOG_WRAPPER_WITH_BUFFER(log_buffer, log_buffer_size, writeDeferred(log_buffer, log_buffer_size, record));
+            record.release();
+        }
 
-                if (enable_print_log_type_ && NULL != level) {
-                    start_index = sprintf(log_buffer, "[Log %8s]", level);
-                    if (start_index < 0) {
-                        start_index = 14;
+        size_t LogWrapper::terminate(char* log_buffer, size_t log_buffer_size, int start_index) {
+            log_buffer[log_buffer_size - 1] = 0;
+            if (start_index >= 0 && static_cast<size_t>(start_index) < log_buffer_size) {
+                log_buffer[start_index] = 0;
+                return static_cast<size_t>(start_index);
+            }
+
+            return log_buffer_size - 1;
+        }
+
+        int LogWrapper::formatPrefix(char* log_buffer, size_t log_buffer_size, const char* level, const char* file_path,
+                                     uint32_t line_number, const char* func_name, const tm* log_tm, uint32_t log_usec) {
+            // format => "[Log    DEBUG][2015-01-12 10:09:08]
+            int start_index = 0;
+
+            if (enable_print_log_type_ && NULL != level) {
+                start_index = sprintf(log_buffer, "[Log %8s]", level);
+                if (start_index < 0) {
+                    start_index = 14;
+                }
+            }
+
+            if (!enable_print_time_.empty()) {
+                if (0 == print_time_subsec_digits_) {
+                    start_index += strftime(&log_buffer[start_index], log_buffer_size - start_index,
+                                            enable_print_time_.c_str(), log_tm);
+                } else {
+                    // strftime不支持秒以下的部分，在%3N或%6N的位置分两段输出
+                    start_index += strftime(&log_buffer[start_index], log_buffer_size - start_index,
+                                            print_time_prefix_.c_str(), log_tm);
+                    int res = 3 == print_time_subsec_digits_ ?
+                        snprintf(&log_buffer[start_index], log_buffer_size - start_index, "%03u", log_usec / 1000) :
+                        snprintf(&log_buffer[start_index], log_buffer_size - start_index, "%06u", log_usec);
+                    // 和strftime一样，放不下时不计入长度
+                    if (res > 0 && static_cast<size_t>(res) < log_buffer_size - start_index) {
+                        start_index += res;
                     }
+                    start_index += strftime(&log_buffer[start_index], log_buffer_size - start_index,
+                                            print_time_suffix_.c_str(), log_tm);
                 }
+            }
 
-                // 是否需要毫秒级？std::chrono
-                if (!enable_print_time_.empty()) {
-                    start_index += strftime(&log_buffer[start_index], sizeof(log_buffer) - start_index,
-                                            enable_print_time_.c_str(), log_time_cache_sec_p_);
+            // 打印位置选项
+            if (enable_print_file_location_ && enable_print_function_name_ &&
+                NULL != file_path && NULL != func_name) {
+                int res = sprintf(&log_buffer[start_index], "[%s:%u(%s)]: ", file_path, line_number, func_name);
+                start_index += res >= 0 ? res : 0;
+            } else if (enable_print_file_location_ && NULL != file_path) {
+                int res = sprintf(&log_buffer[start_index], "[%s:%u]: ", file_path, line_number);
+                start_index += res >= 0 ? res : 0;
+            } else if (enable_print_function_name_ && NULL != func_name) {
+                int res = sprintf(&log_buffer[start_index], "[(%s)]: ", func_name);
+                start_index += res >= 0 ? res : 0;
+            }
+
+            return start_index;
+        }
+
+        void LogWrapper::setEnablePrintTime(const std::string& enable_print_time) {
+            enable_print_time_ = enable_print_time;
+            print_time_subsec_digits_ = 0;
+            print_time_prefix_.clear();
+            print_time_suffix_.clear();
+
+            // 只处理第一个%3N或%6N
+            for (size_t i = 0; i + 2 < enable_print_time.size(); ++i) {
+                if ('%' != enable_print_time[i]) {
+                    continue;
                 }
 
-                // 打印位置选项
-                if (enable_print_file_location_ && enable_print_function_name_ &&
-                    NULL != file_path && NULL != func_name) {
-                    int res = sprintf(&log_buffer[start_index], "[%s:%u(%s)]: ", file_path, line_number, func_name);
-                    start_index += res >= 0 ? res : 0;
-                } else if (enable_print_file_location_ && NULL != file_path) {
-                    int res = sprintf(&log_buffer[start_index], "[%s:%u]: ", file_path, line_number);
-                    start_index += res >= 0 ? res : 0;
-                } else if (enable_print_function_name_ && NULL != func_name) {
-                    int res = sprintf(&log_buffer[start_index], "[(%s)]: ", func_name);
-                    start_index += res >= 0 ? res : 0;
+                if (('3' == enable_print_time[i + 1] || '6' == enable_print_time[i + 1]) && 'N' == enable_print_time[i + 2]) {
+                    print_time_subsec_digits_ = enable_print_time[i + 1] - '0';
+                    print_time_prefix_ = enable_print_time.substr(0, i);
+                    print_time_suffix_ = enable_print_time.substr(i + 3);
+                    break;
                 }
 
+                // 跳过%%之类的转义
+                ++i;
+            }
+        }
 
-                va_list va_args;
-                va_start(va_args, fmt);
+        void LogWrapper::dispatch(level_t::type level_id, const char* level, const char* content) {
+            for (std::list<log_router_t>::iterator iter = log_handlers_.begin(); iter != log_handlers_.end(); ++iter) {
+                if (level_id >= iter->level_min && level_id <= iter->level_max) {
+                    iter->handle(level_id, level, content);
+                }
+            }
+        }
 
-                start_index += vsnprintf(&log_buffer[start_index], sizeof(log_buffer) - start_index, fmt, va_args);
+        int32_t LogWrapper::startAsync(size_t queue_size, overflow_policy_t::type policy) {
+            if (async_running_.load(std::memory_order_acquire) || async_thread_.joinable()) {
+                return -1;
+            }
 
-                va_end(va_args);
+            async_queue_.reset(new util::ds::mpmc_ring_queue<async_record_t>(queue_size));
+            async_policy_ = policy;
+            async_stop_.store(false, std::memory_order_relaxed);
+            async_thread_ = std::thread(&LogWrapper::asyncWriterMain, this);
+            async_running_.store(true, std::memory_order_release);
+            return 0;
+        }
+
+        void LogWrapper::stopAsync() {
+            // 写线程不能等待自己退出
+            if (!async_thread_.joinable() || isAsyncWriter()) {
+                return;
+            }
+
+            // 新的日志恢复为同步输出，然后等正在写入队列的线程完成
+            async_running_.store(false, std::memory_order_seq_cst);
+            while (0 != async_producers_.get(util::lock::memory_order_seq_cst)) {
+                std::this_thread::yield();
+            }
+
+            async_stop_.store(true, std::memory_order_release);
+            async_thread_.join();
+            async_queue_.reset();
+        }
+
+        void LogWrapper::flush() {
+            // 写线程上调用时等待的就是自己，直接返回
+            if (!async_running_.load(std::memory_order_acquire) || isAsyncWriter()) {
+                return;
+            }
+
+            uint64_t target = async_push_count_.get(util::lock::memory_order_acquire);
+            while (async_done_count_.get(util::lock::memory_order_acquire) < target) {
+                std::this_thread::sleep_for(std::chrono::microseconds(LOG_WRAPPER_ASYNC_IDLE_SLEEP_US));
+            }
+        }
+
+        bool LogWrapper::pushAsync(async_record_t& record) {
+            // 先登记再检查状态，和stopAsync的先修改状态再等待登记数归零对应
+            async_producers_.inc(util::lock::memory_order_seq_cst);
+            if (!async_running_.load(std::memory_order_seq_cst)) {
+                async_producers_.dec(util::lock::memory_order_release);
+                return false;
+            }
+
+            bool pushed = true;
+            while (!async_queue_->try_push(record)) {
+                if (overflow_policy_t::DROP_NEWEST == async_policy_) {
+                    record.release();
+                    pushed = false;
+                    async_drop_count_.inc(util::lock::memory_order_relaxed);
+                    break;
+                }
+
+                if (overflow_policy_t::DROP_OLDEST == async_policy_) {
+                    async_record_t oldest;
+                    if (async_queue_->try_pop(oldest)) {
+                        oldest.release();
+                        async_drop_count_.inc(util::lock::memory_order_relaxed);
+                        async_done_count_.inc(util::lock::memory_order_release);
+                    }
+                    continue;
+                }
+
+                std::this_thread::yield();
+            }
+
+            if (pushed) {
+                async_push_count_.inc(util::lock::memory_order_release);
+            }
+
+            async_producers_.dec(util::lock::memory_order_release);
+            return true;
+        }
+
+        size_t LogWrapper::asyncDrain(size_t max_count) {
+            async_record_t records[LOG_WRAPPER_ASYNC_BATCH_SIZE];
+            size_t ret = 0;
+            while (ret < max_count) {
+                size_t n = 0;
+                while (n < LOG_WRAPPER_ASYNC_BATCH_SIZE && ret + n < max_count && async_queue_->try_pop(records[n])) {
+                    ++n;
+                }
+
+                if (0 == n) {
+                    break;
+                }
+
+                // 输出里读取的是写线程自己的时间缓存
+                if (auto_update_time_) {
+                    update();
+                }
+
+                for (size_t i = 0; i < n; ++i) {
+                    if (NULL == records[i].formatter) {
+                        dispatch(records[i].level_id, records[i].level, records[i].content());
+                    } else {
+                        LOG_WRAPPER_WITH_BUFFER(log_buffer, log_buffer_size, writeDeferred(log_buffer, log_buffer_size, records[i]));
+                    }
+                    records[i].release();
+                }
+
+                async_done_count_.add(n, util::lock::memory_order_release);
+                ret += n;
+            }
+
+            return ret;
+        }
+
+        bool LogWrapper::isAsyncWriter() const {
+#if defined(THREAD_TLS_ENABLED)
+            return this == detail::g_log_async_writer;
+#else
+            return async_thread_.get_id() == std::this_thread::get_id();
+#endif
+        }
+
+        void LogWrapper::asyncWriterMain() {
+#if defined(THREAD_TLS_ENABLED)
+            detail::g_log_async_writer = this;
+#endif
 
-                log_buffer[sizeof(log_buffer) - 1] = 0;
-                if (static_cast<size_t>(start_index) < sizeof(log_buffer)) {
-                    log_buffer[start_index] = 0;
+            while (true) {
+                if (0 != asyncDrain(LOG_WRAPPER_ASYNC_BATCH_SIZE)) {
+                    continue;
                 }
 
-                for (std::list<log_router_t>::iterator iter = log_handlers_.begin(); iter != log_handlers_.end(); ++iter) {
-                    if (level_id >= iter->level_min && level_id <= iter->level_max) {
-                        iter->handle(level_id, level, log_buffer);
+                // stopAsync保证设置停止标记后不会再有新的写入，队列已空就可以退出
+                if (async_stop_.load(std::memory_order_acquire)) {
+                    if (0 == asyncDrain(static_cast<size_t>(-1))) {
+                        break;
                     }
+                    continue;
                 }
 
+                std::this_thread::sleep_for(std::chrono::microseconds(LOG_WRAPPER_ASYNC_IDLE_SLEEP_US));
             }
         }
 
-        LogWrapper* LogWrapper::getLogCat(uint32_t cats) {
+        LogWrapper* LogWrapper::initLogCat(uint32_t cats) {
             if (LogWrapper::destroyed_) {
                 return NULL;
             }
@@ -119,6 +554,7 @@ namespace util {
                 return NULL;
             }
 
+            all_logger_.store(all_logger, std::memory_order_release);
             return &all_logger[cats];
         }
 
@@ -0,0 +1,145 @@
+#include <cstring>
+#include <vector>
+#include <thread>
+
+#include "frame/test_macros.h"
+
+#ifdef max
+#undef max
+#endif
+
+#include "MemPool/concurrent_lru_pool.h"
+
+
+struct test_concurrent_lru_data {
+    uint32_t key;
+};
+
+static util::lock::seq_alloc_u64 g_concurrent_lru_stat[4];
+
+struct test_concurrent_lru_action : public util::mempool::lru_default_action<test_concurrent_lru_data> {
+    typedef util::mempool::lru_default_action<test_concurrent_lru_data> base_type;
+    void push(test_concurrent_lru_data* obj) {
+        g_concurrent_lru_stat[0].inc();
+    }
+
+    void pull(test_concurrent_lru_data* obj) {
+        g_concurrent_lru_stat[1].inc();
+    }
+
+    void reset(test_concurrent_lru_data* obj) {
+        g_concurrent_lru_stat[2].inc();
+    }
+
+    void gc(test_concurrent_lru_data* obj) {
+        g_concurrent_lru_stat[3].inc();
+        base_type::gc(obj);
+    }
+};
+
+typedef util::mempool::concurrent_lru_pool<uint32_t, test_concurrent_lru_data, test_concurrent_lru_action> test_concurrent_lru_pool_t;
+
+static void reset_concurrent_lru_stat() {
+    for (int i = 0; i < 4; ++i) {
+        g_concurrent_lru_stat[i].set(0);
+    }
+}
+
+CASE_TEST(ConcurrentLRUPool, basic)
+{
+    reset_concurrent_lru_stat();
+    {
+        test_concurrent_lru_pool_t pool;
+        CASE_EXPECT_EQ(0, pool.init(3, 2, 4));
+        CASE_EXPECT_EQ(4, pool.shard_size());
+        CASE_EXPECT_EQ(2, pool.magazine_size());
+
+        test_concurrent_lru_data* objs[8];
+        for (int i = 0; i < 8; ++i) {
+            objs[i] = new test_concurrent_lru_data();
+            CASE_EXPECT_TRUE(pool.push(static_cast<uint32_t>(i % 2), objs[i]));
+        }
+
+        // 4 in magazine and 4 spilled into shards
+        CASE_EXPECT_EQ(8, pool.size());
+        CASE_EXPECT_EQ(8, g_concurrent_lru_stat[0].get());
+
+        CASE_EXPECT_EQ(objs[7], pool.pull(1));
+        CASE_EXPECT_EQ(objs[5], pool.pull(1));
+        CASE_EXPECT_EQ(objs[3], pool.pull(1));
+        CASE_EXPECT_EQ(objs[1], pool.pull(1));
+        CASE_EXPECT_EQ(NULL, pool.pull(1));
+        CASE_EXPECT_EQ(NULL, pool.pull(2));
+        CASE_EXPECT_EQ(4, g_concurrent_lru_stat[1].get());
+        CASE_EXPECT_EQ(4, g_concurrent_lru_stat[2].get());
+
+        for (int i = 0; i < 4; ++i) {
+            delete objs[i * 2 + 1];
+        }
+
+        pool.flush_magazines();
+        CASE_EXPECT_EQ(4, pool.size());
+        CASE_EXPECT_EQ(objs[6], pool.pull(0));
+        delete objs[6];
+
+        CASE_EXPECT_EQ(0, g_concurrent_lru_stat[3].get());
+    }
+
+    CASE_EXPECT_EQ(3, g_concurrent_lru_stat[3].get());
+}
+
+static void concurrent_lru_pool_worker(test_concurrent_lru_pool_t* pool, util::lock::seq_alloc_u64* alloc_count, int loop, uint32_t key_num) {
+    std::vector<test_concurrent_lru_data*> holds;
+    holds.reserve(8);
+
+    for (int i = 0; i < loop; ++i) {
+        uint32_t key = static_cast<uint32_t>(i) % key_num;
+        for (int j = 0; j < 8; ++j) {
+            test_concurrent_lru_data* obj = pool->pull(key);
+            if (NULL == obj) {
+                obj = new test_concurrent_lru_data();
+                obj->key = key;
+                alloc_count->inc();
+            }
+
+            CASE_EXPECT_EQ(key, obj->key);
+            holds.push_back(obj);
+        }
+
+        for (size_t j = 0; j < holds.size(); ++j) {
+            pool->push(key, holds[j]);
+        }
+        holds.clear();
+    }
+}
+
+CASE_TEST(ConcurrentLRUPool, multi_thread)
+{
+    reset_concurrent_lru_stat();
+    util::lock::seq_alloc_u64 alloc_count;
+
+    const int thread_num = 4;
+    const int loop = 20000;
+    {
+        test_concurrent_lru_pool_t pool;
+        CASE_EXPECT_EQ(0, pool.init(16, thread_num, 32));
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_num; ++i) {
+            threads.push_back(std::thread(concurrent_lru_pool_worker, &pool, &alloc_count, loop, 64));
+        }
+
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+
+        uint64_t ops = static_cast<uint64_t>(thread_num) * loop * 8 * 2;
+
+        CASE_EXPECT_EQ(alloc_count.get(), pool.size() + g_concurrent_lru_stat[3].get());
+        CASE_EXPECT_EQ(g_concurrent_lru_stat[0].get(), ops / 2);
+        pool.gc();
+    }
+
+    // nothing leaked
+    CASE_EXPECT_EQ(alloc_count.get(), g_concurrent_lru_stat[3].get());
+}
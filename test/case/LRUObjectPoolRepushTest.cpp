@@ -0,0 +1,102 @@
+#include <cstring>
+#include <vector>
+
+#include "frame/test_macros.h"
+
+#ifdef max
+#undef max
+#endif
+
+// 这个文件单独开启重复push检测，所以用到的类型都不能和LRUObjectPoolTest.cpp重名
+#define _UTIL_MEMPOOL_LRUOBJECTPOOL_CHECK_REPUSH
+#include "MemPool/lru_object_pool.h"
+#include "MemPool/concurrent_lru_pool.h"
+
+
+struct test_lru_repush_data {};
+
+CASE_TEST(LRUObjectPool, pointer_set)
+{
+    util::mempool::detail::lru_pointer_set<test_lru_repush_data> s;
+    std::vector<test_lru_repush_data> objs(1000);
+
+    CASE_EXPECT_TRUE(s.empty());
+    CASE_EXPECT_FALSE(s.insert(NULL));
+    for (size_t i = 0; i < objs.size(); ++i) {
+        CASE_EXPECT_TRUE(s.insert(&objs[i]));
+    }
+    CASE_EXPECT_EQ(objs.size(), s.size());
+    CASE_EXPECT_LE(s.size() * 2, s.capacity());
+    CASE_EXPECT_FALSE(s.insert(&objs[0]));
+
+    // 删除一半，剩下的必须仍然能找到（检查后移删除）
+    for (size_t i = 0; i < objs.size(); i += 2) {
+        CASE_EXPECT_TRUE(s.erase(&objs[i]));
+    }
+    CASE_EXPECT_FALSE(s.erase(&objs[0]));
+    CASE_EXPECT_EQ(objs.size() / 2, s.size());
+
+    size_t found = 0;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        if (s.contains(&objs[i])) {
+            CASE_EXPECT_EQ(1, i & 0x01);
+            ++found;
+        }
+    }
+    CASE_EXPECT_EQ(objs.size() / 2, found);
+
+    s.clear();
+    CASE_EXPECT_TRUE(s.empty());
+    CASE_EXPECT_FALSE(s.contains(&objs[1]));
+}
+
+CASE_TEST(LRUObjectPool, check_repush)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_repush_data> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+
+    test_lru_repush_data* obj = new test_lru_repush_data();
+    CASE_EXPECT_TRUE(lru.push(1, obj));
+    CASE_EXPECT_FALSE(lru.push(1, obj));
+    CASE_EXPECT_FALSE(lru.push(2, obj));
+    CASE_EXPECT_EQ(1, lru.size());
+
+    // pull出来以后可以再次push
+    CASE_EXPECT_EQ(obj, lru.pull(1));
+    CASE_EXPECT_TRUE(lru.push(2, obj));
+
+    // gc后检测表也要清理
+    lru.clear();
+    CASE_EXPECT_TRUE(lru.empty());
+}
+
+CASE_TEST(ConcurrentLRUPool, shard_reject)
+{
+    typedef util::mempool::concurrent_lru_pool<uint32_t, test_lru_repush_data> test_concurrent_lru_pool_t;
+    test_concurrent_lru_pool_t pool;
+    CASE_EXPECT_EQ(0, pool.init(1, 1, 2));
+
+    // 分片会拒绝重复push的对象，被拒绝的对象既不能丢失也不能被释放
+    test_lru_repush_data* obj = new test_lru_repush_data();
+    CASE_EXPECT_TRUE(pool.push(1, obj));
+    CASE_EXPECT_TRUE(pool.push(1, obj));
+    // magazine满了，较旧的一个放进分片
+    CASE_EXPECT_TRUE(pool.push(1, obj));
+    CASE_EXPECT_EQ(3, pool.size());
+
+    // 放回分片被拒绝，留在magazine里；新的对象也放不进分片，返回失败
+    CASE_EXPECT_FALSE(pool.push(1, obj));
+    CASE_EXPECT_EQ(3, pool.size());
+
+    pool.flush_magazines();
+    CASE_EXPECT_EQ(3, pool.size());
+
+    for (int i = 0; i < 3; ++i) {
+        CASE_EXPECT_EQ(obj, pool.pull(1));
+    }
+    CASE_EXPECT_EQ(NULL, pool.pull(1));
+    CASE_EXPECT_EQ(0, pool.size());
+    delete obj;
+}
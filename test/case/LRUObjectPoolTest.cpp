@@ -1,4 +1,5 @@
-#include <cstring>
+﻿#include <cstring>
+#include <vector>
 
 #include "frame/test_macros.h"
 
@@ -261,3 +262,387 @@ CASE_TEST(LRUObjectPool, adjust_bound)
         CASE_EXPECT_EQ(128, mgr->list_count().get());
     }
 }
+
+CASE_TEST(LRUObjectPool, slab_storage)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action, util::mempool::lru_slab_list_storage<4> > test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    mgr->set_proc_item_count(16);
+    mgr->set_proc_list_count(16);
+
+    memset(&g_stat_lru, 0, sizeof(g_stat_lru));
+    test_lru_data* checked_ptr[16];
+
+    for (int i = 0; i < 16; ++i) {
+        CASE_EXPECT_TRUE(lru.push(static_cast<uint32_t>(i % 2), checked_ptr[i] = new test_lru_data()));
+    }
+    CASE_EXPECT_EQ(16, lru.size());
+    CASE_EXPECT_EQ(16, mgr->item_count().get());
+
+    // FILO in every key
+    for (int i = 0; i < 8; ++i) {
+        CASE_EXPECT_EQ(checked_ptr[15 - i * 2], lru.pull(1));
+    }
+    CASE_EXPECT_EQ(NULL, lru.pull(1));
+
+    for (int i = 0; i < 8; ++i) {
+        CASE_EXPECT_TRUE(lru.push(1, checked_ptr[15 - i * 2]));
+    }
+
+    CASE_EXPECT_EQ(24, g_stat_lru[0]);
+    CASE_EXPECT_EQ(8, g_stat_lru[1]);
+    CASE_EXPECT_EQ(8, g_stat_lru[2]);
+    CASE_EXPECT_EQ(0, g_stat_lru[3]);
+
+    // gc from the oldest one
+    CASE_EXPECT_EQ(8, mgr->gc());
+    CASE_EXPECT_EQ(8, g_stat_lru[3]);
+
+    lru.clear();
+    CASE_EXPECT_TRUE(lru.empty());
+    CASE_EXPECT_EQ(16, g_stat_lru[3]);
+}
+
+CASE_TEST(LRUObjectPool, check_list_handle)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr1 = util::mempool::lru_pool_manager::create();
+    util::mempool::lru_pool_manager::ptr_t mgr2 = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr1);
+
+    memset(&g_stat_lru, 0, sizeof(g_stat_lru));
+
+    // list of key 1 is destroyed after pull, its check items must be skipped
+    test_lru_data* check_ptr = new test_lru_data();
+    CASE_EXPECT_TRUE(lru.push(1, check_ptr));
+    CASE_EXPECT_EQ(check_ptr, lru.pull(1));
+    CASE_EXPECT_TRUE(lru.push(2, new test_lru_data()));
+    CASE_EXPECT_TRUE(lru.push(1, check_ptr));
+
+    CASE_EXPECT_EQ(3, mgr1->list_count().get());
+    CASE_EXPECT_EQ(2, mgr1->item_count().get());
+
+    // more than the initial capacity of the ring queue
+    for (int i = 0; i < 40; ++i) {
+        CASE_EXPECT_EQ(check_ptr, lru.pull(1));
+        CASE_EXPECT_TRUE(lru.push(1, check_ptr));
+    }
+    CASE_EXPECT_EQ(43, mgr1->list_count().get());
+
+    // move to another manager, all handles in mgr1 are expired
+    lru.set_manager(mgr2);
+    CASE_EXPECT_EQ(0, mgr1->item_count().get());
+    CASE_EXPECT_EQ(2, mgr2->item_count().get());
+    mgr1->set_gc_list(0);
+    mgr1->set_gc_item(0);
+    CASE_EXPECT_EQ(0, mgr1->gc());
+    CASE_EXPECT_EQ(0, g_stat_lru[3]);
+
+    CASE_EXPECT_TRUE(lru.push(3, new test_lru_data()));
+    CASE_EXPECT_EQ(1, mgr2->list_count().get());
+    CASE_EXPECT_EQ(3, mgr2->item_count().get());
+    CASE_EXPECT_EQ(1, mgr2->gc());
+    CASE_EXPECT_EQ(1, g_stat_lru[3]);
+}
+
+struct test_lru_sized_data {
+    size_t size;
+    test_lru_sized_data(size_t s) : size(s) {}
+};
+
+struct test_lru_sized_action : public util::mempool::lru_default_action<test_lru_sized_data> {
+    size_t size(test_lru_sized_data* obj) {
+        return obj->size;
+    }
+};
+
+CASE_TEST(LRUObjectPool, byte_bound)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_sized_data, test_lru_sized_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    mgr->set_proc_item_count(16);
+    mgr->set_proc_list_count(16);
+    mgr->set_byte_max_bound(4096);
+    mgr->set_byte_min_bound(2048);
+
+    for (int i = 0; i < 16; ++i) {
+        CASE_EXPECT_TRUE(lru.push(static_cast<uint32_t>(i % 4), new test_lru_sized_data(256)));
+    }
+    CASE_EXPECT_EQ(4096, mgr->byte_count().get());
+    CASE_EXPECT_EQ(16, mgr->item_count().get());
+
+    test_lru_sized_data* big = new test_lru_sized_data(1024);
+    CASE_EXPECT_TRUE(lru.push(5, big));
+
+    // 5120 bytes => evict the oldest objects until no more than 2048 bytes
+    CASE_EXPECT_EQ(2048, mgr->byte_count().get());
+    CASE_EXPECT_EQ(5, mgr->item_count().get());
+    CASE_EXPECT_EQ(big, lru.pull(5));
+    CASE_EXPECT_EQ(1024, mgr->byte_count().get());
+    delete big;
+
+    // move to another manager with byte total
+    util::mempool::lru_pool_manager::ptr_t mgr2 = util::mempool::lru_pool_manager::create();
+    lru.set_manager(mgr2);
+    CASE_EXPECT_EQ(0, mgr->byte_count().get());
+    CASE_EXPECT_EQ(1024, mgr2->byte_count().get());
+
+    // action without size hook do not count bytes
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action> test_lru_nosize_pool_t;
+    test_lru_nosize_pool_t lru_nosize;
+    lru_nosize.init(mgr2);
+    CASE_EXPECT_TRUE(lru_nosize.push(1, new test_lru_data()));
+    CASE_EXPECT_EQ(1024, mgr2->byte_count().get());
+    CASE_EXPECT_EQ(5, mgr2->item_count().get());
+}
+
+CASE_TEST(LRUObjectPool, proc_with_empty_check_list)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_sized_data, test_lru_sized_action> test_lru_pool_t;
+    test_lru_pool_t lru;
+    test_lru_sized_data* obj = new test_lru_sized_data(1024);
+    CASE_EXPECT_TRUE(lru.push(1, obj));
+    CASE_EXPECT_TRUE(lru.push(2, new test_lru_sized_data(1024)));
+
+    // 关联管理器时不会生成检查项，管理器只计入已有的对象
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    mgr->set_byte_max_bound(1024);
+    mgr->set_byte_min_bound(512);
+    lru.set_manager(mgr);
+    CASE_EXPECT_EQ(2048, mgr->byte_count().get());
+    CASE_EXPECT_EQ(2, mgr->item_count().get());
+
+    CASE_EXPECT_EQ(0, mgr->proc(1));
+    CASE_EXPECT_EQ(2048, mgr->byte_count().get());
+    CASE_EXPECT_EQ(2, mgr->item_count().get());
+
+    CASE_EXPECT_EQ(obj, lru.pull(1));
+    delete obj;
+    CASE_EXPECT_EQ(1024, mgr->byte_count().get());
+    CASE_EXPECT_EQ(1, mgr->item_count().get());
+}
+
+CASE_TEST(LRUObjectPool, stat)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action> test_lru_pool_t;
+    typedef util::mempool::lru_pool_manager::stat_type_t stat_type_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    mgr->set_proc_item_count(16);
+    mgr->set_proc_list_count(16);
+    mgr->set_item_max_bound(8);
+    mgr->set_item_adjust_min(4);
+    mgr->set_list_tick_timeout(10);
+
+    // disabled by default
+    CASE_EXPECT_FALSE(mgr->get_enable_stat());
+    CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+    CASE_EXPECT_EQ(0, mgr->get_stat().counters[stat_type_t::PUSH]);
+    lru.clear();
+    mgr->set_enable_stat(true);
+
+    mgr->proc(1);
+    for (int i = 0; i < 8; ++i) {
+        CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+    }
+
+    test_lru_data* obj = lru.pull(1);
+    CASE_EXPECT_NE(NULL, obj);
+    CASE_EXPECT_EQ(NULL, lru.pull(2));
+    CASE_EXPECT_TRUE(lru.push(1, obj));
+
+    // 10 items > 8, evicted by item bound
+    CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+    CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+
+    util::mempool::lru_pool_manager::stat_t st = mgr->get_stat();
+    CASE_EXPECT_EQ(11, st.counters[stat_type_t::PUSH]);
+    CASE_EXPECT_EQ(1, st.counters[stat_type_t::PULL_HIT]);
+    CASE_EXPECT_EQ(1, st.counters[stat_type_t::PULL_MISS]);
+    CASE_EXPECT_LT(0, st.counters[stat_type_t::EVICT_ITEM_BOUND]);
+    CASE_EXPECT_EQ(0, st.counters[stat_type_t::EVICT_TIMEOUT]);
+    CASE_EXPECT_EQ(mgr->item_count().get(), st.item_count);
+    CASE_EXPECT_EQ(mgr->get_item_max_bound(), st.item_max_bound);
+
+    // all left check items timeout
+    size_t left = mgr->item_count().get();
+    CASE_EXPECT_EQ(left, mgr->proc(100));
+    st = mgr->get_stat();
+    CASE_EXPECT_EQ(left, st.counters[stat_type_t::EVICT_TIMEOUT]);
+    CASE_EXPECT_EQ(0, st.item_count);
+
+    // manual gc drifts the adaptive bounds
+    for (int i = 0; i < 4; ++i) {
+        CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+    }
+    size_t freed = mgr->gc();
+    st = mgr->get_stat();
+    CASE_EXPECT_EQ(freed, st.counters[stat_type_t::GC]);
+    CASE_EXPECT_EQ(mgr->get_item_min_bound(), st.item_min_bound);
+    CASE_EXPECT_EQ(mgr->get_list_bound(), st.list_bound);
+}
+
+CASE_TEST(LRUObjectPool, size_and_empty)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_sized_data, test_lru_sized_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    CASE_EXPECT_TRUE(lru.empty());
+    CASE_EXPECT_EQ(0, lru.size());
+
+    // counters are kept without a manager
+    for (int i = 0; i < 6; ++i) {
+        CASE_EXPECT_TRUE(lru.push(static_cast<uint32_t>(i % 3), new test_lru_sized_data(10)));
+    }
+    CASE_EXPECT_FALSE(lru.empty());
+    CASE_EXPECT_EQ(6, lru.size());
+    CASE_EXPECT_EQ(2, lru.size(0));
+    CASE_EXPECT_EQ(0, lru.size(3));
+    CASE_EXPECT_EQ(60, lru.byte_size());
+
+    lru.init(mgr);
+    CASE_EXPECT_EQ(6, mgr->item_count().get());
+    CASE_EXPECT_EQ(60, mgr->byte_count().get());
+
+    delete lru.pull(0);
+    delete lru.pull(0);
+    CASE_EXPECT_EQ(4, lru.size());
+    CASE_EXPECT_EQ(0, lru.size(0));
+    CASE_EXPECT_EQ(40, lru.byte_size());
+
+    lru.clear();
+    CASE_EXPECT_TRUE(lru.empty());
+    CASE_EXPECT_EQ(0, lru.size());
+    CASE_EXPECT_EQ(0, lru.byte_size());
+
+    // gc by manager
+    util::mempool::lru_pool_manager::ptr_t mgr2 = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru2;
+    lru2.init(mgr2);
+    for (int i = 0; i < 4; ++i) {
+        CASE_EXPECT_TRUE(lru2.push(7, new test_lru_sized_data(10)));
+    }
+    mgr2->set_gc_item(2);
+    CASE_EXPECT_EQ(2, mgr2->proc(0));
+    CASE_EXPECT_EQ(2, lru2.size());
+    CASE_EXPECT_EQ(2, lru2.size(7));
+    CASE_EXPECT_EQ(20, lru2.byte_size());
+    CASE_EXPECT_FALSE(lru2.empty());
+}
+
+static uint64_t g_test_lru_ttl_now = 0;
+static uint64_t test_lru_ttl_clock() {
+    return g_test_lru_ttl_now;
+}
+
+CASE_TEST(LRUObjectPool, ttl_timer_wheel)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+
+    g_test_lru_ttl_now = 1000000000;
+    mgr->set_ttl_clock(test_lru_ttl_clock);
+    mgr->set_ttl_resolution(1000);        // 1us
+    mgr->set_ttl(1000000);                // 1ms
+    mgr->set_proc_item_count(4);
+    memset(&g_stat_lru, 0, sizeof(g_stat_lru));
+
+    // key 1 pushed at t, key 2 pushed at t + 0.5ms
+    for (int i = 0; i < 6; ++i) {
+        CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+    }
+    g_test_lru_ttl_now += 500000;
+    CASE_EXPECT_TRUE(lru.push(2, new test_lru_data()));
+    CASE_EXPECT_TRUE(lru.push(1, new test_lru_data()));
+
+    // not expired yet
+    g_test_lru_ttl_now += 499000;
+    CASE_EXPECT_EQ(0, mgr->proc(0));
+    CASE_EXPECT_EQ(8, lru.size());
+
+    // key 1 expires exactly at t + 1ms, bounded by proc_item_count
+    g_test_lru_ttl_now += 1000;
+    CASE_EXPECT_EQ(4, mgr->proc(0));
+    CASE_EXPECT_EQ(2, mgr->proc(0));
+    CASE_EXPECT_EQ(0, mgr->proc(0));
+    CASE_EXPECT_EQ(6, g_stat_lru[3]);
+    CASE_EXPECT_EQ(2, lru.size());
+    CASE_EXPECT_EQ(1, lru.size(1));
+
+    // a pulled list leaves a stale timer behind
+    delete lru.pull(2);
+    g_test_lru_ttl_now += 500000;
+    CASE_EXPECT_EQ(1, mgr->proc(0));
+    CASE_EXPECT_TRUE(lru.empty());
+
+    // long ttl goes through the upper levels of the wheel
+    mgr->set_ttl(3600000000000ULL);
+    CASE_EXPECT_TRUE(lru.push(3, new test_lru_data()));
+    g_test_lru_ttl_now += 3599999999000ULL;
+    CASE_EXPECT_EQ(0, mgr->proc(0));
+    g_test_lru_ttl_now += 1000;
+    CASE_EXPECT_EQ(1, mgr->proc(0));
+    CASE_EXPECT_TRUE(lru.empty());
+}
+
+CASE_TEST(LRUObjectPool, bulk_push_pull)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_data, test_lru_action, util::mempool::lru_slab_list_storage<> > test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    mgr->set_proc_item_count(1000);
+    memset(&g_stat_lru, 0, sizeof(g_stat_lru));
+
+    std::vector<test_lru_data*> objs;
+    for (int i = 0; i < 100; ++i) {
+        objs.push_back(new test_lru_data());
+    }
+    objs.push_back(NULL);
+
+    CASE_EXPECT_EQ(100, lru.push_n(1, objs.begin(), objs.end()));
+    CASE_EXPECT_EQ(100, lru.size(1));
+    CASE_EXPECT_EQ(100, mgr->item_count().get());
+    CASE_EXPECT_EQ(1, mgr->list_count().get());
+    CASE_EXPECT_EQ(100, g_stat_lru[0]);
+
+    // FILO
+    test_lru_data* out[64];
+    CASE_EXPECT_EQ(40, lru.pull_n(1, out, 40));
+    for (int i = 0; i < 40; ++i) {
+        CASE_EXPECT_EQ(objs[99 - i], out[i]);
+    }
+    CASE_EXPECT_EQ(60, lru.size());
+    CASE_EXPECT_EQ(60, mgr->item_count().get());
+    CASE_EXPECT_EQ(40, g_stat_lru[1]);
+
+    // one check item covers the whole batch
+    mgr->set_gc_item(10);
+    CASE_EXPECT_EQ(50, mgr->proc(0));
+    CASE_EXPECT_EQ(10, lru.size());
+    CASE_EXPECT_EQ(50, g_stat_lru[3]);
+    CASE_EXPECT_EQ(1, mgr->list_count().get());
+
+    CASE_EXPECT_EQ(10, lru.pull_n(1, out, 64));
+    for (int i = 0; i < 10; ++i) {
+        CASE_EXPECT_EQ(objs[59 - i], out[i]);
+    }
+    CASE_EXPECT_EQ(0, lru.pull_n(1, out, 64));
+    CASE_EXPECT_TRUE(lru.empty());
+
+    // items pushed back after a partial pull are not covered by the old check item
+    CASE_EXPECT_EQ(10, lru.push_n(2, out, out + 10));
+    mgr->set_gc_item(5);
+    CASE_EXPECT_EQ(5, mgr->proc(0));
+    CASE_EXPECT_EQ(5, lru.size(2));
+    CASE_EXPECT_EQ(1, mgr->list_count().get());
+    lru.clear();
+}
@@ -0,0 +1,93 @@
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "frame/test_macros.h"
+
+#ifdef max
+#undef max
+#endif
+
+#include "MemPool/lru_reclaimer.h"
+
+
+struct test_lru_reclaimer_data {};
+
+static util::lock::seq_alloc_u64 g_lru_reclaimer_gc_count;
+static std::thread::id g_lru_reclaimer_gc_thread;
+
+struct test_lru_reclaimer_action : public util::mempool::lru_default_action<test_lru_reclaimer_data> {
+    typedef util::mempool::lru_default_action<test_lru_reclaimer_data> base_type;
+    void gc(test_lru_reclaimer_data* obj) {
+        g_lru_reclaimer_gc_thread = std::this_thread::get_id();
+        g_lru_reclaimer_gc_count.inc();
+        base_type::gc(obj);
+    }
+};
+
+CASE_TEST(LRUReclaimer, inline_fallback)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_reclaimer_data, test_lru_reclaimer_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    util::mempool::lru_reclaimer::ptr_t reclaimer = util::mempool::lru_reclaimer::create(4);
+    mgr->set_reclaimer(reclaimer);
+
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    g_lru_reclaimer_gc_count.set(0);
+
+    // not started, objects are reclaimed on the caller's thread
+    for (int i = 0; i < 8; ++i) {
+        CASE_EXPECT_TRUE(lru.push(1, new test_lru_reclaimer_data()));
+    }
+    lru.clear();
+    CASE_EXPECT_EQ(8, g_lru_reclaimer_gc_count.get());
+    CASE_EXPECT_TRUE(std::this_thread::get_id() == g_lru_reclaimer_gc_thread);
+
+    util::mempool::lru_reclaimer::stat_t st = reclaimer->get_stat();
+    CASE_EXPECT_EQ(8, st.inline_count);
+    CASE_EXPECT_EQ(0, st.push_count);
+    CASE_EXPECT_EQ(4, st.capacity);
+}
+
+CASE_TEST(LRUReclaimer, background)
+{
+    typedef util::mempool::lru_pool<uint32_t, test_lru_reclaimer_data, test_lru_reclaimer_action> test_lru_pool_t;
+    util::mempool::lru_pool_manager::ptr_t mgr = util::mempool::lru_pool_manager::create();
+    util::mempool::lru_reclaimer::ptr_t reclaimer = util::mempool::lru_reclaimer::create(1024);
+    reclaimer->set_idle_sleep(100);
+    CASE_EXPECT_EQ(0, reclaimer->start());
+    CASE_EXPECT_TRUE(reclaimer->is_running());
+    mgr->set_reclaimer(reclaimer);
+    mgr->set_item_adjust_min(0);
+    mgr->set_item_max_bound(16);
+
+    test_lru_pool_t lru;
+    lru.init(mgr);
+    g_lru_reclaimer_gc_count.set(0);
+
+    for (int i = 0; i < 4096; ++i) {
+        CASE_EXPECT_TRUE(lru.push(static_cast<uint32_t>(i % 7), new test_lru_reclaimer_data()));
+    }
+    lru.clear();
+
+    util::mempool::lru_reclaimer::stat_t st = reclaimer->get_stat();
+    CASE_EXPECT_EQ(4096, st.push_count + st.inline_count);
+    CASE_EXPECT_LE(st.max_depth, st.capacity);
+    CASE_MSG_INFO() << "reclaimer: push " << st.push_count << ", inline " << st.inline_count << ", max depth " << st.max_depth << std::endl;
+
+    for (int i = 0; i < 1000 && g_lru_reclaimer_gc_count.get() < 4096; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    mgr->set_reclaimer(util::mempool::lru_reclaimer::ptr_t());
+    reclaimer->stop();
+    CASE_EXPECT_FALSE(reclaimer->is_running());
+    CASE_EXPECT_EQ(4096, g_lru_reclaimer_gc_count.get());
+
+    st = reclaimer->get_stat();
+    CASE_EXPECT_EQ(0, st.depth);
+    CASE_EXPECT_EQ(st.push_count, st.reclaim_count);
+}
@@ -1,8 +1,20 @@
 ﻿#include <typeinfo>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <chrono>
 #include "frame/test_macros.h"
 
 #include "Lock/SpinLock.h"
+#include "Lock/TicketLock.h"
+#include "Lock/MCSLock.h"
+#include "Lock/TTASSpinLock.h"
+#include "Lock/RWSpinLock.h"
+#include "Lock/SeqLock.h"
+#include "Lock/FutexLock.h"
+#include "Lock/seq_alloc.h"
 #include "Lock/LockHolder.h"
+#include "Lock/MultiLockHolder.h"
 
 CASE_TEST(LockTest, SpinLock)
 {
@@ -42,3 +54,434 @@ CASE_TEST(LockTest, LockHolder)
     
     CASE_EXPECT_FALSE(lock.IsLocked());
 }
+
+template<typename TLock>
+static void lock_test_basic()
+{
+    TLock lock;
+    CASE_EXPECT_FALSE(lock.IsLocked());
+
+    lock.Lock();
+    CASE_EXPECT_TRUE(lock.IsLocked());
+
+    CASE_EXPECT_FALSE(lock.TryLock());
+
+    lock.Unlock();
+    CASE_EXPECT_FALSE(lock.IsLocked());
+
+    CASE_EXPECT_TRUE(lock.TryLock());
+    CASE_EXPECT_TRUE(lock.TryUnlock());
+    CASE_EXPECT_FALSE(lock.TryUnlock());
+
+    {
+        util::lock::LockHolder<TLock> holder(lock);
+        CASE_EXPECT_TRUE(lock.IsLocked());
+        CASE_EXPECT_TRUE(holder.IsAvailable());
+    }
+    CASE_EXPECT_FALSE(lock.IsLocked());
+}
+
+CASE_TEST(LockTest, TicketLock)
+{
+    lock_test_basic<util::lock::TicketLock>();
+}
+
+CASE_TEST(LockTest, MCSLock)
+{
+    lock_test_basic<util::lock::MCSLock>();
+}
+
+CASE_TEST(LockTest, FutexLock)
+{
+    lock_test_basic<util::lock::FutexLock>();
+
+    // 持有锁的时间远超自旋时间，等待者会挂起
+    util::lock::FutexLock lock;
+    int counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&lock, &counter]() {
+            for (int j = 0; j < 100; ++j) {
+                util::lock::LockHolder<util::lock::FutexLock> holder(lock);
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+                ++counter;
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(400, counter);
+    CASE_EXPECT_FALSE(lock.IsLocked());
+}
+
+CASE_TEST(LockTest, TTASSpinLock)
+{
+    lock_test_basic<util::lock::TTASSpinLock>();
+
+    util::lock::TTASSpinLock lock;
+    util::lock::TTASSpinLock::BackoffOption opt = util::lock::TTASSpinLock::DefaultBackoffOption();
+    opt.min_pause = 0;
+    opt.max_pause = 0;
+    opt.yield_after = 4;
+    opt.sleep_after = 2;
+    lock.SetBackoffOption(opt);
+    CASE_EXPECT_EQ(1, lock.GetBackoffOption().min_pause);
+    CASE_EXPECT_EQ(1, lock.GetBackoffOption().max_pause);
+    CASE_EXPECT_EQ(4, lock.GetBackoffOption().sleep_after);
+
+    lock.SetEnableStat(true);
+    lock.Lock();
+    std::thread waiter([&lock]() {
+        lock.Lock();
+        lock.Unlock();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    lock.Unlock();
+    waiter.join();
+
+    util::lock::TTASSpinLock::Stat st = lock.GetStat();
+    CASE_EXPECT_EQ(2, st.acquire_count);
+    CASE_EXPECT_EQ(1, st.contended_count);
+    CASE_EXPECT_GT(st.pause_count + st.yield_count + st.sleep_count, 0);
+    CASE_MSG_INFO() << "TTASSpinLock waiter: pause " << st.pause_count << ", yield " << st.yield_count << ", sleep " << st.sleep_count << std::endl;
+
+    lock.ResetStat();
+    CASE_EXPECT_EQ(0, lock.GetStat().acquire_count);
+}
+
+CASE_TEST(LockTest, RWSpinLock)
+{
+    lock_test_basic<util::lock::RWSpinLock>();
+
+    typedef util::lock::LockHolder<util::lock::RWSpinLock,
+        util::lock::detail::DefaultReadLockAction<util::lock::RWSpinLock>,
+        util::lock::detail::DefaultReadUnlockAction<util::lock::RWSpinLock> > read_holder_t;
+    typedef util::lock::LockHolder<util::lock::RWSpinLock,
+        util::lock::detail::DefaultTryReadLockAction<util::lock::RWSpinLock>,
+        util::lock::detail::DefaultReadUnlockAction<util::lock::RWSpinLock> > try_read_holder_t;
+
+    util::lock::RWSpinLock lock;
+    {
+        read_holder_t holder1(lock);
+        read_holder_t holder2(lock);
+        CASE_EXPECT_TRUE(lock.IsReadLocked());
+        CASE_EXPECT_FALSE(lock.IsLocked());
+        CASE_EXPECT_FALSE(lock.TryLock());
+    }
+    CASE_EXPECT_FALSE(lock.IsReadLocked());
+
+    {
+        util::lock::LockHolder<util::lock::RWSpinLock> holder(lock);
+        try_read_holder_t try_holder(lock);
+        CASE_EXPECT_FALSE(try_holder.IsAvailable());
+    }
+
+    // writers keep a == b, readers must never see them differ
+    int a = 0, b = 0;
+    util::lock::seq_alloc_u32 bad_read;
+    bad_read.set(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&lock, &a, &b, &bad_read]() {
+            for (int j = 0; j < 10000; ++j) {
+                read_holder_t holder(lock);
+                if (a != b) {
+                    bad_read.inc();
+                }
+            }
+        }));
+    }
+    for (int i = 0; i < 2; ++i) {
+        threads.push_back(std::thread([&lock, &a, &b]() {
+            for (int j = 0; j < 1000; ++j) {
+                util::lock::LockHolder<util::lock::RWSpinLock> holder(lock);
+                ++a;
+                ++b;
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(0, bad_read.get());
+    CASE_EXPECT_EQ(2000, a);
+    CASE_EXPECT_EQ(2000, b);
+}
+
+struct test_seq_lock_data {
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+};
+
+CASE_TEST(LockTest, SeqLock)
+{
+    lock_test_basic<util::lock::SeqLock>();
+
+    util::lock::SeqLock lock;
+    uint32_t seq = lock.ReadBegin();
+    CASE_EXPECT_FALSE(lock.ReadRetry(seq));
+    seq = lock.ReadBegin();
+    lock.Lock();
+    lock.Unlock();
+    CASE_EXPECT_TRUE(lock.ReadRetry(seq));
+
+    test_seq_lock_data init_data = { 0, 0, 0 };
+    util::lock::SeqLockValue<test_seq_lock_data> value(init_data);
+    util::lock::seq_alloc_u32 bad_read;
+    bad_read.set(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&value, &bad_read]() {
+            for (int j = 0; j < 10000; ++j) {
+                test_seq_lock_data d = value.Load();
+                if (d.a != d.b || d.b != d.c) {
+                    bad_read.inc();
+                }
+            }
+        }));
+    }
+    threads.push_back(std::thread([&value]() {
+        for (uint64_t j = 1; j <= 10000; ++j) {
+            test_seq_lock_data d = { j, j, j };
+            value.Store(d);
+        }
+    }));
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(0, bad_read.get());
+    CASE_EXPECT_EQ(10000, value.Load().c);
+}
+
+CASE_TEST(LockTest, SeqLock_multi_writer)
+{
+    // 多个写者通过GetRawData原地累加，写者之间没有同步时会丢失修改
+    test_seq_lock_data init_data = { 0, 0, 0 };
+    util::lock::SeqLockValue<test_seq_lock_data> value(init_data);
+    util::lock::seq_alloc_u32 bad_read;
+    bad_read.set(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&value]() {
+            for (int j = 0; j < 10000; ++j) {
+                util::lock::LockHolder<util::lock::SeqLock> holder(value.GetLock());
+                test_seq_lock_data* d = value.GetRawData();
+                ++d->a;
+                ++d->b;
+                d->c = d->a + d->b;
+            }
+        }));
+    }
+    threads.push_back(std::thread([&value, &bad_read]() {
+        for (int j = 0; j < 10000; ++j) {
+            test_seq_lock_data d = value.Load();
+            if (d.a != d.b || d.c != d.a + d.b) {
+                bad_read.inc();
+            }
+        }
+    }));
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    test_seq_lock_data res = value.Load();
+    CASE_EXPECT_EQ(0, bad_read.get());
+    CASE_EXPECT_EQ(40000, res.a);
+    CASE_EXPECT_EQ(40000, res.b);
+    CASE_EXPECT_EQ(80000, res.c);
+}
+
+CASE_TEST(LockTest, padded_seq_alloc)
+{
+    struct test_padded_layout {
+        util::lock::padded_seq_alloc_u64 a;
+        util::lock::padded_seq_alloc_u64 b;
+    };
+    test_padded_layout layout;
+    const char* pa = reinterpret_cast<const char*>(static_cast<util::lock::seq_alloc_u64*>(&layout.a));
+    const char* pb = reinterpret_cast<const char*>(static_cast<util::lock::seq_alloc_u64*>(&layout.b));
+    CASE_EXPECT_GE(static_cast<size_t>(pb - pa), 64);
+
+    // usable as seq_alloc
+    util::lock::seq_alloc_u64& ref = layout.a;
+    ref.set(10);
+    CASE_EXPECT_EQ(11, layout.a.inc());
+    CASE_EXPECT_EQ(10, layout.a.dec());
+    CASE_EXPECT_EQ(10, layout.a.get());
+}
+
+CASE_TEST(LockTest, sharded_seq_alloc)
+{
+    util::lock::sharded_seq_alloc_u64 counter;
+    CASE_EXPECT_EQ(0, counter.get());
+    counter.set(5);
+    counter.inc();
+    counter.add(4);
+    counter.sub(2);
+    counter.dec();
+    CASE_EXPECT_EQ(7, counter.get());
+    counter.inc(util::lock::memory_order_seq_cst);
+    counter.add(2, util::lock::memory_order_release);
+    counter.sub(2, util::lock::memory_order_relaxed);
+    counter.dec(util::lock::memory_order_release);
+    CASE_EXPECT_EQ(7, counter.get(util::lock::memory_order_acquire));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.push_back(std::thread([&counter]() {
+            for (int j = 0; j < 10000; ++j) {
+                counter.inc();
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(80007, counter.get());
+}
+
+CASE_TEST(LockTest, MultiLockHolder)
+{
+    util::lock::SpinLock a, b;
+    util::lock::RWSpinLock rw;
+
+    {
+        util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SpinLock> holder(b, a);
+        CASE_EXPECT_EQ(2, holder.size());
+        CASE_EXPECT_TRUE(a.IsLocked());
+        CASE_EXPECT_TRUE(b.IsLocked());
+    }
+    CASE_EXPECT_FALSE(a.IsLocked());
+    CASE_EXPECT_FALSE(b.IsLocked());
+
+    // 同一个锁只加锁一次
+    {
+        util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SpinLock> holder(a, a);
+        CASE_EXPECT_EQ(1, holder.size());
+        CASE_EXPECT_TRUE(a.IsLocked());
+    }
+    CASE_EXPECT_FALSE(a.IsLocked());
+
+    // 共享模式
+    {
+        util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SharedLock<util::lock::RWSpinLock> > holder(a, rw);
+        CASE_EXPECT_TRUE(rw.IsReadLocked());
+        CASE_EXPECT_FALSE(rw.IsLocked());
+        CASE_EXPECT_TRUE(rw.TryReadLock());
+        rw.ReadUnlock();
+    }
+    CASE_EXPECT_FALSE(rw.IsReadLocked());
+
+    // 同一个锁同时有共享和独占，按独占加锁
+    {
+        util::lock::MultiLockHolder<util::lock::SharedLock<util::lock::RWSpinLock>, util::lock::ExclusiveLock<util::lock::RWSpinLock> > holder(rw, rw);
+        CASE_EXPECT_EQ(1, holder.size());
+        CASE_EXPECT_TRUE(rw.IsLocked());
+        CASE_EXPECT_FALSE(rw.IsReadLocked());
+    }
+    CASE_EXPECT_FALSE(rw.IsLocked());
+
+    // 不同线程按相反顺序传入，不会死锁
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&a, &b, &counter, i]() {
+            for (int j = 0; j < 10000; ++j) {
+                if (i & 0x01) {
+                    util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SpinLock> holder(a, b);
+                    ++counter;
+                } else {
+                    util::lock::MultiLockHolder<util::lock::SpinLock, util::lock::SpinLock> holder(b, a);
+                    ++counter;
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(40000, counter);
+}
+
+CASE_TEST(LockTest, seq_alloc_memory_order)
+{
+    util::lock::seq_alloc_u32 seq;
+    seq.set(0, util::lock::memory_order_relaxed);
+    CASE_EXPECT_EQ(1, seq.inc(util::lock::memory_order_relaxed));
+    CASE_EXPECT_EQ(1, seq.add(2, util::lock::memory_order_acq_rel));
+    CASE_EXPECT_EQ(3, seq.sub(1, util::lock::memory_order_release));
+    CASE_EXPECT_EQ(1, seq.dec(util::lock::memory_order_relaxed));
+    CASE_EXPECT_EQ(1, seq.bor(6, util::lock::memory_order_relaxed));
+    CASE_EXPECT_EQ(7, seq.band(5, util::lock::memory_order_relaxed));
+    CASE_EXPECT_EQ(5, seq.bxor(1, util::lock::memory_order_relaxed));
+    CASE_EXPECT_FALSE(seq.compare_exchange(5, 9, util::lock::memory_order_acq_rel));
+    CASE_EXPECT_TRUE(seq.compare_exchange(4, 9, util::lock::memory_order_release));
+    CASE_EXPECT_EQ(9, seq.get(util::lock::memory_order_acquire));
+
+    // relaxed的分配序号依然唯一
+    util::lock::seq_alloc_u64 id_alloc;
+    id_alloc.set(0);
+    std::vector<std::vector<uint64_t> > ids(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        std::vector<uint64_t>* out = &ids[i];
+        threads.push_back(std::thread([&id_alloc, out]() {
+            for (int j = 0; j < 10000; ++j) {
+                out->push_back(id_alloc.inc(util::lock::memory_order_relaxed));
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        all.insert(all.end(), ids[i].begin(), ids[i].end());
+    }
+    std::sort(all.begin(), all.end());
+    CASE_EXPECT_TRUE(std::unique(all.begin(), all.end()) == all.end());
+    CASE_EXPECT_EQ(40000, id_alloc.get(util::lock::memory_order_relaxed));
+}
+
+template<typename TLock>
+static void lock_test_contention(size_t thread_num, size_t loop_times)
+{
+    TLock lock;
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < thread_num; ++i) {
+        threads.push_back(std::thread([&lock, &counter, loop_times]() {
+            for (size_t j = 0; j < loop_times; ++j) {
+                util::lock::LockHolder<TLock> holder(lock);
+                ++counter;
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(thread_num * loop_times, counter);
+}
+
+// 耗时对比见benchmark/Benchmark.cpp
+CASE_TEST(LockTest, contention)
+{
+    lock_test_contention<util::lock::SpinLock>(8, 4096);
+    lock_test_contention<util::lock::TTASSpinLock>(8, 4096);
+    lock_test_contention<util::lock::TicketLock>(8, 4096);
+    lock_test_contention<util::lock::MCSLock>(8, 4096);
+    lock_test_contention<util::lock::FutexLock>(8, 4096);
+}
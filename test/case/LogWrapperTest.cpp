@@ -0,0 +1,424 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include "frame/test_macros.h"
+
+#include "log/LogWrapper.h"
+
+// 每个用例使用单独的日志分类，避免互相影响
+struct test_log_wrapper_sink {
+    std::vector<std::string> contents;
+    std::vector<std::thread::id> threads;
+    std::atomic<bool> blocked;
+    std::atomic<bool> entered;
+
+    test_log_wrapper_sink() {
+        blocked.store(false);
+        entered.store(false);
+    }
+
+    void operator()(util::log::LogWrapper::level_t::type, const char*, const char* content) {
+        entered.store(true);
+        while (blocked.load()) {
+            std::this_thread::yield();
+        }
+
+        contents.push_back(content);
+        threads.push_back(std::this_thread::get_id());
+    }
+};
+
+static util::log::LogWrapper* test_log_wrapper_setup(uint32_t cat, test_log_wrapper_sink& sink) {
+    util::log::LogWrapper* logger = WLOG_GETCAT(cat);
+    logger->init(util::log::LogWrapper::level_t::LOG_LW_DEBUG);
+    logger->clearLogHandle();
+    logger->setEnablePrintLogType(false);
+    logger->setEnablePrintTime("");
+    logger->setEnablePrintFileLocation(false);
+    logger->setEnablePrintFunctionName(false);
+    logger->addLogHandle([&sink](util::log::LogWrapper::level_t::type level_id, const char* level, const char* content) {
+        sink(level_id, level, content);
+    });
+    return logger;
+}
+
+CASE_TEST(LogWrapperTest, async_block)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+
+    CASE_EXPECT_EQ(0, logger->startAsync(16, util::log::LogWrapper::overflow_policy_t::BLOCK));
+    CASE_EXPECT_TRUE(logger->isAsync());
+    CASE_EXPECT_NE(0, logger->startAsync());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([i]() {
+            for (int j = 0; j < 1000; ++j) {
+                WCLOGINFO(1, "thread %d line %d", i, j);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    logger->flush();
+    CASE_EXPECT_EQ(4000, sink.contents.size());
+    CASE_EXPECT_EQ(0, logger->getAsyncDropCount());
+
+    // 输出只在写线程上调用
+    size_t writer_thread_count = 0;
+    for (size_t i = 0; i < sink.threads.size(); ++i) {
+        if (sink.threads[i] == sink.threads[0]) {
+            ++writer_thread_count;
+        }
+    }
+    CASE_EXPECT_EQ(4000, writer_thread_count);
+    CASE_EXPECT_TRUE(sink.threads[0] != std::this_thread::get_id());
+
+    // 停止后恢复同步输出
+    WCLOGINFO(1, "tail");
+    logger->stopAsync();
+    CASE_EXPECT_FALSE(logger->isAsync());
+    WCLOGINFO(1, "sync");
+    CASE_EXPECT_EQ(4002, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("tail"), sink.contents[4000]);
+    CASE_EXPECT_TRUE(sink.threads[4001] == std::this_thread::get_id());
+
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, async_drop_newest)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(2, sink);
+    CASE_EXPECT_EQ(0, logger->startAsync(2, util::log::LogWrapper::overflow_policy_t::DROP_NEWEST));
+
+    // 第一条被写线程取走并阻塞在输出里，之后两条填满队列，剩下的被丢弃
+    sink.blocked.store(true);
+    WCLOGINFO(2, "%d", 0);
+    while (!sink.entered.load()) {
+        std::this_thread::yield();
+    }
+    for (int i = 1; i < 6; ++i) {
+        WCLOGINFO(2, "%d", i);
+    }
+    sink.blocked.store(false);
+
+    logger->flush();
+    CASE_EXPECT_EQ(3, logger->getAsyncDropCount());
+    CASE_EXPECT_EQ(3, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("0"), sink.contents[0]);
+    CASE_EXPECT_EQ(std::string("1"), sink.contents[1]);
+    CASE_EXPECT_EQ(std::string("2"), sink.contents[2]);
+
+    logger->stopAsync();
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, async_drop_oldest)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(3, sink);
+    CASE_EXPECT_EQ(0, logger->startAsync(2, util::log::LogWrapper::overflow_policy_t::DROP_OLDEST));
+
+    sink.blocked.store(true);
+    WCLOGINFO(3, "%d", 0);
+    while (!sink.entered.load()) {
+        std::this_thread::yield();
+    }
+    for (int i = 1; i < 6; ++i) {
+        WCLOGINFO(3, "%d", i);
+    }
+    sink.blocked.store(false);
+
+    logger->flush();
+    CASE_EXPECT_EQ(3, logger->getAsyncDropCount());
+    CASE_EXPECT_EQ(3, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("0"), sink.contents[0]);
+    CASE_EXPECT_EQ(std::string("4"), sink.contents[1]);
+    CASE_EXPECT_EQ(std::string("5"), sink.contents[2]);
+
+    logger->stopAsync();
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, thread_local_time_cache)
+{
+    util::log::LogWrapper::update();
+    const tm* main_tm = util::log::LogWrapper::getLogTm();
+    time_t main_time = util::log::LogWrapper::getLogTime();
+    CASE_EXPECT_TRUE(NULL != main_tm);
+
+    const tm* other_tm = NULL;
+    time_t other_time = 0;
+    int other_year = 0;
+    std::thread t([&other_tm, &other_time, &other_year]() {
+        // 没有update过的线程也能拿到有效的时间
+        other_tm = util::log::LogWrapper::getLogTm();
+        other_time = util::log::LogWrapper::getLogTime();
+        other_year = other_tm->tm_year;
+    });
+    t.join();
+
+    // 每个线程有独立的缓存
+    CASE_EXPECT_TRUE(main_tm != other_tm);
+    CASE_EXPECT_GE(other_time, main_time);
+
+    tm expect_tm;
+#if defined(_MSC_VER)
+    localtime_s(&expect_tm, &main_time);
+#else
+    localtime_r(&main_time, &expect_tm);
+#endif
+    CASE_EXPECT_EQ(expect_tm.tm_year, main_tm->tm_year);
+    CASE_EXPECT_EQ(expect_tm.tm_yday, main_tm->tm_yday);
+    CASE_EXPECT_EQ(expect_tm.tm_sec, main_tm->tm_sec);
+    CASE_EXPECT_EQ(main_tm->tm_year, other_year);
+}
+
+CASE_TEST(LogWrapperTest, manual_update_time)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+    logger->setAutoUpdate(false);
+    logger->setEnablePrintTime("%H:%M:%S.%6N");
+
+    // 关闭自动更新后，外部调用update()对其他线程也生效
+    std::atomic<int> step;
+    step.store(0);
+    std::thread t([&step]() {
+        WCLOGINFO(1, "first");
+        step.store(1);
+        while (2 != step.load()) {
+            std::this_thread::yield();
+        }
+        WCLOGINFO(1, "second");
+    });
+
+    while (1 != step.load()) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    util::log::LogWrapper::update();
+    char expect[32] = {0};
+    size_t len = strftime(expect, sizeof(expect), "%H:%M:%S", util::log::LogWrapper::getLogTm());
+    snprintf(expect + len, sizeof(expect) - len, ".%06usecond", util::log::LogWrapper::getLogTimeUsec());
+    step.store(2);
+    t.join();
+
+    CASE_EXPECT_EQ(2, sink.contents.size());
+    CASE_EXPECT_NE(sink.contents[0].substr(0, 15), sink.contents[1].substr(0, 15));
+    CASE_EXPECT_EQ(std::string(expect), sink.contents[1]);
+
+    logger->setAutoUpdate(true);
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, nested_log)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+
+    // 输出里再写日志时使用单独的缓冲区，不会破坏外层后面的输出拿到的内容
+    bool nested = false;
+    logger->clearLogHandle();
+    logger->addLogHandle([&nested](util::log::LogWrapper::level_t::type, const char*, const char*) {
+        if (!nested) {
+            nested = true;
+            WCLOGINFO(1, "inner");
+        }
+    });
+    logger->addLogHandle([&sink](util::log::LogWrapper::level_t::type level_id, const char* level, const char* content) {
+        sink(level_id, level, content);
+    });
+
+    WCLOGINFO(1, "outer %d", 1);
+    CASE_EXPECT_EQ(2, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("inner"), sink.contents[0]);
+    CASE_EXPECT_EQ(std::string("outer 1"), sink.contents[1]);
+
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, async_nested_log)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+    CASE_EXPECT_EQ(0, logger->startAsync(2, util::log::LogWrapper::overflow_policy_t::BLOCK));
+
+    // 写线程在输出里写日志时队列是满的，只能在写线程上同步输出，flush和stopAsync也不能等待自己
+    std::atomic<bool> entered;
+    std::atomic<bool> filled;
+    entered.store(false);
+    filled.store(false);
+    bool nested = false;
+    logger->clearLogHandle();
+    logger->addLogHandle([&nested, &entered, &filled, logger](util::log::LogWrapper::level_t::type, const char*, const char*) {
+        if (!nested) {
+            nested = true;
+            entered.store(true);
+            while (!filled.load()) {
+                std::this_thread::yield();
+            }
+
+            for (int i = 0; i < 4; ++i) {
+                WCLOGINFO(1, "inner %d", i);
+                WCLOGDEFERINFO(1, "deferred inner %d", i);
+            }
+            logger->flush();
+            logger->stopAsync();
+        }
+    });
+    logger->addLogHandle([&sink](util::log::LogWrapper::level_t::type level_id, const char* level, const char* content) {
+        sink(level_id, level, content);
+    });
+
+    WCLOGINFO(1, "outer");
+    while (!entered.load()) {
+        std::this_thread::yield();
+    }
+    WCLOGINFO(1, "fill %d", 1);
+    WCLOGINFO(1, "fill %d", 2);
+    filled.store(true);
+    logger->flush();
+
+    CASE_EXPECT_TRUE(logger->isAsync());
+    CASE_EXPECT_EQ(11, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("inner 0"), sink.contents[0]);
+    CASE_EXPECT_EQ(std::string("deferred inner 3"), sink.contents[7]);
+    CASE_EXPECT_EQ(std::string("outer"), sink.contents[8]);
+    CASE_EXPECT_EQ(std::string("fill 2"), sink.contents[10]);
+    CASE_EXPECT_TRUE(sink.threads[0] == sink.threads[10]);
+    CASE_EXPECT_TRUE(sink.threads[0] != std::this_thread::get_id());
+
+    logger->stopAsync();
+    logger->clearLogHandle();
+}
+
+CASE_TEST(LogWrapperTest, deferred)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+    logger->setEnablePrintTime("%Y-%m-%d %H:%M:%S");
+    logger->setEnablePrintFileLocation(true);
+
+    // 延迟格式化的输出和直接格式化的输出一致
+    char name[] = "deferred";
+    for (int mode = 0; mode < 2; ++mode) {
+        if (1 == mode) {
+            CASE_EXPECT_EQ(0, logger->startAsync(16));
+        }
+
+        size_t base = sink.contents.size();
+        WCLOGINFO(1, "%s %d %u %lld %.3f %c %s", name, -1, 2u, 3LL, 4.5, 'x', "literal");
+        WCLOGDEFERINFO(1, "%s %d %u %lld %.3f %c %s", name, -1, 2u, 3LL, 4.5, 'x', "literal");
+        WCLOGDEFERINFO(1, "no argument");
+        logger->flush();
+
+        CASE_EXPECT_EQ(base + 3, sink.contents.size());
+        CASE_EXPECT_EQ(sink.contents[base].size(), sink.contents[base + 1].size());
+        // 两次调用的行号不同，比较行号后面的内容
+        CASE_EXPECT_TRUE(NULL != strstr(sink.contents[base + 1].c_str(), "deferred -1 2 3 4.500 x literal"));
+        CASE_EXPECT_TRUE(NULL != strstr(sink.contents[base + 2].c_str(), "no argument"));
+    }
+
+    // 字符串参数在调用时拷贝，之后修改不影响输出
+    unsigned char bytes[] = "bytes";
+    sink.blocked.store(true);
+    WCLOGDEFERINFO(1, "%s", name);
+    WCLOGDEFERINFO(1, "%s", bytes);
+    strcpy(name, "modified");
+    bytes[0] = 'B';
+    sink.blocked.store(false);
+    logger->flush();
+    CASE_EXPECT_TRUE(NULL != strstr(sink.contents[sink.contents.size() - 2].c_str(), "deferred"));
+    CASE_EXPECT_TRUE(NULL != strstr(sink.contents.back().c_str(), "bytes"));
+
+    // 超过记录内置空间的内容改为单独分配
+    std::string long_text(LOG_WRAPPER_ASYNC_RECORD_INLINE_SIZE * 2, 'L');
+    WCLOGINFO(1, "%s", long_text.c_str());
+    WCLOGDEFERINFO(1, "%s", long_text.c_str());
+    logger->flush();
+    CASE_EXPECT_TRUE(NULL != strstr(sink.contents[sink.contents.size() - 2].c_str(), long_text.c_str()));
+    CASE_EXPECT_TRUE(NULL != strstr(sink.contents.back().c_str(), long_text.c_str()));
+
+    logger->stopAsync();
+    logger->clearLogHandle();
+}
+
+static int test_log_wrapper_count_call(int* counter) {
+    return ++(*counter);
+}
+
+// 把编译期级别临时调到Info，只对下面的用例生效
+#undef LOG_WRAPPER_COMPILE_LEVEL
+#define LOG_WRAPPER_COMPILE_LEVEL util::log::LogWrapper::level_t::LOG_LW_INFO
+
+CASE_TEST(LogWrapperTest, compile_level)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+    int counter = 0;
+
+    // 低于编译期级别的语句连参数都不会求值
+    WCLOGDEBUG(1, "debug %d", test_log_wrapper_count_call(&counter));
+    WCLOGNOTICE(1, "notice %d", test_log_wrapper_count_call(&counter));
+    WCLOGDEFERDEBUG(1, "deferred debug %d", test_log_wrapper_count_call(&counter));
+    CASE_EXPECT_EQ(0, counter);
+    CASE_EXPECT_EQ(0, sink.contents.size());
+
+    WCLOGINFO(1, "info %d", test_log_wrapper_count_call(&counter));
+    WCLOGDEFERWARNING(1, "deferred warning %d", test_log_wrapper_count_call(&counter));
+    CASE_EXPECT_EQ(2, counter);
+    CASE_EXPECT_EQ(2, sink.contents.size());
+    CASE_EXPECT_EQ(std::string("info 1"), sink.contents[0]);
+    CASE_EXPECT_EQ(std::string("deferred warning 2"), sink.contents[1]);
+
+    // 运行时级别仍然生效
+    logger->init(util::log::LogWrapper::level_t::LOG_LW_ERROR);
+    WCLOGINFO(1, "info %d", test_log_wrapper_count_call(&counter));
+    CASE_EXPECT_EQ(2, sink.contents.size());
+
+    logger->init(util::log::LogWrapper::level_t::LOG_LW_DEBUG);
+    logger->clearLogHandle();
+}
+
+#undef LOG_WRAPPER_COMPILE_LEVEL
+#define LOG_WRAPPER_COMPILE_LEVEL util::log::LogWrapper::level_t::LOG_LW_DEBUG
+
+CASE_TEST(LogWrapperTest, sub_second_time)
+{
+    test_log_wrapper_sink sink;
+    util::log::LogWrapper* logger = test_log_wrapper_setup(1, sink);
+
+    util::log::LogWrapper::update();
+    CASE_EXPECT_LT(util::log::LogWrapper::getLogTimeUsec(), 1000000);
+
+    // 默认格式不输出秒以下的部分
+    CASE_EXPECT_EQ(std::string("[%Y-%m-%d %H:%M:%S]"),
+        WLOG_GETCAT(util::log::LogWrapper::categorize_t::DEFAULT)->getEnablePrintTime());
+
+    // 只替换第一个%3N或%6N，%%转义不受影响
+    logger->setEnablePrintTime("[%S.%3N]");
+    WCLOGINFO(1, "ms");
+    logger->setEnablePrintTime("[%S.%6N %%3N]");
+    WCLOGDEFERINFO(1, "us");
+    logger->setEnablePrintTime("[%S]");
+    WCLOGINFO(1, "sec");
+
+    CASE_EXPECT_EQ(3, sink.contents.size());
+    CASE_EXPECT_EQ(strlen("[00.000]ms"), sink.contents[0].size());
+    CASE_EXPECT_EQ('.', sink.contents[0][3]);
+    CASE_EXPECT_EQ(']', sink.contents[0][7]);
+    CASE_EXPECT_EQ(strlen("[00.000000 %3N]us"), sink.contents[1].size());
+    CASE_EXPECT_TRUE(NULL != strstr(sink.contents[1].c_str(), " %3N]us"));
+    CASE_EXPECT_EQ(strlen("[00]sec"), sink.contents[2].size());
+
+    logger->clearLogHandle();
+}
@@ -0,0 +1,185 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "frame/test_macros.h"
+
+#include "DataStructure/lock_free_array.h"
+#include "DataStructure/mpmc_ring_queue.h"
+#include "DataStructure/spsc_ring_queue.h"
+
+
+CASE_TEST(RingQueueTest, lock_free_array_empty)
+{
+    util::ds::lock_free_array<int, 4> arr;
+    CASE_EXPECT_TRUE(arr.empty());
+    CASE_EXPECT_EQ(4, arr.capacity());
+
+    *arr.push_back() = 1;
+    CASE_EXPECT_FALSE(arr.empty());
+    CASE_EXPECT_EQ(1, arr.size());
+    CASE_EXPECT_EQ(1, *arr.pop_front());
+    CASE_EXPECT_TRUE(arr.empty());
+}
+
+CASE_TEST(RingQueueTest, mpmc_basic)
+{
+    util::ds::mpmc_ring_queue<std::unique_ptr<int> > queue(3);
+    CASE_EXPECT_EQ(4, queue.capacity());
+    CASE_EXPECT_TRUE(queue.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        CASE_EXPECT_TRUE(queue.try_push(std::unique_ptr<int>(new int(i))));
+    }
+    CASE_EXPECT_FALSE(queue.try_push(std::unique_ptr<int>(new int(4))));
+    CASE_EXPECT_EQ(4, queue.size());
+
+    std::unique_ptr<int> out;
+    for (int i = 0; i < 4; ++i) {
+        CASE_EXPECT_TRUE(queue.try_pop(out));
+        CASE_EXPECT_EQ(i, *out);
+    }
+    CASE_EXPECT_FALSE(queue.try_pop(out));
+    CASE_EXPECT_TRUE(queue.empty());
+
+    // 析构时释放剩余的元素
+    CASE_EXPECT_TRUE(queue.try_push(std::unique_ptr<int>(new int(5))));
+}
+
+static void ring_queue_test_mpmc(size_t producer_num, size_t consumer_num, size_t loop_times)
+{
+    util::ds::mpmc_ring_queue<size_t> queue(1024);
+    std::atomic<size_t> pop_count;
+    std::atomic<size_t> pop_sum;
+    pop_count.store(0);
+    pop_sum.store(0);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < producer_num; ++i) {
+        threads.push_back(std::thread([&queue, loop_times]() {
+            for (size_t j = 1; j <= loop_times; ++j) {
+                while (!queue.try_push(j)) {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    size_t total = producer_num * loop_times;
+    for (size_t i = 0; i < consumer_num; ++i) {
+        threads.push_back(std::thread([&queue, &pop_count, &pop_sum, total]() {
+            size_t v;
+            while (pop_count.load(std::memory_order_relaxed) < total) {
+                if (queue.try_pop(v)) {
+                    pop_sum.fetch_add(v, std::memory_order_relaxed);
+                    pop_count.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    CASE_EXPECT_EQ(total, pop_count.load());
+    CASE_EXPECT_EQ(producer_num * loop_times * (loop_times + 1) / 2, pop_sum.load());
+    CASE_EXPECT_TRUE(queue.empty());
+}
+
+// 耗时对比见benchmark/Benchmark.cpp
+CASE_TEST(RingQueueTest, mpmc_multi_thread)
+{
+    ring_queue_test_mpmc(1, 1, 16384);
+    ring_queue_test_mpmc(4, 4, 4096);
+}
+
+CASE_TEST(RingQueueTest, spsc_basic)
+{
+    util::ds::spsc_ring_queue<std::unique_ptr<int> > queue(4);
+    CASE_EXPECT_EQ(4, queue.capacity());
+
+    for (int i = 0; i < 4; ++i) {
+        CASE_EXPECT_TRUE(queue.try_push(std::unique_ptr<int>(new int(i))));
+    }
+    CASE_EXPECT_FALSE(queue.try_push(std::unique_ptr<int>(new int(4))));
+
+    std::unique_ptr<int> out;
+    CASE_EXPECT_TRUE(queue.try_pop(out));
+    CASE_EXPECT_EQ(0, *out);
+    CASE_EXPECT_EQ(3, queue.size());
+
+    // 析构时释放剩余的元素
+}
+
+CASE_TEST(RingQueueTest, spsc_batch)
+{
+    util::ds::spsc_ring_queue<int> queue(8);
+    int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    int out[10] = {0};
+
+    CASE_EXPECT_EQ(5, queue.push_n(in, in + 5));
+    CASE_EXPECT_EQ(3, queue.pop_n(out, 3));
+    CASE_EXPECT_EQ(2, out[2]);
+
+    // 跨越数组边界并且只写入剩余空间
+    CASE_EXPECT_EQ(6, queue.push_n(in + 4, in + 10));
+    CASE_EXPECT_EQ(8, queue.size());
+    CASE_EXPECT_FALSE(queue.try_push(10));
+    CASE_EXPECT_EQ(8, queue.pop_n(out, 10));
+    CASE_EXPECT_EQ(3, out[0]);
+    CASE_EXPECT_EQ(4, out[1]);
+    CASE_EXPECT_EQ(4, out[2]);
+    CASE_EXPECT_EQ(9, out[7]);
+    CASE_EXPECT_EQ(0, queue.pop_n(out, 10));
+    CASE_EXPECT_TRUE(queue.empty());
+}
+
+CASE_TEST(RingQueueTest, spsc_multi_thread)
+{
+    const size_t loop_times = 1 << 16;
+    const size_t batch_size = 64;
+    util::ds::spsc_ring_queue<size_t> queue(1024);
+    size_t sum = 0;
+
+    std::thread producer([&queue, loop_times, batch_size]() {
+        size_t buf[batch_size];
+        size_t next = 1;
+        while (next <= loop_times) {
+            size_t n = 0;
+            for (; n < batch_size && next + n <= loop_times; ++n) {
+                buf[n] = next + n;
+            }
+
+            size_t pushed = queue.push_n(buf, buf + n);
+            next += pushed;
+            if (0 == pushed) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::thread consumer([&queue, &sum, loop_times, batch_size]() {
+        size_t buf[batch_size];
+        size_t count = 0;
+        while (count < loop_times) {
+            size_t n = queue.pop_n(buf, batch_size);
+            for (size_t i = 0; i < n; ++i) {
+                sum += buf[i];
+            }
+            count += n;
+            if (0 == n) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    CASE_EXPECT_EQ(loop_times * (loop_times + 1) / 2, sum);
+}
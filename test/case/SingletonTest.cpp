@@ -2,6 +2,7 @@
 
 #include "frame/test_macros.h"
 #include "DesignPattern/Singleton.h"
+#include "Lock/FutexLock.h"
 
 class SingletonUnitTest : public Singleton<SingletonUnitTest>
 {
@@ -23,3 +24,18 @@ CASE_TEST(SingletonTest, Instance)
     CASE_EXPECT_EQ(1024, pr.i);
 }
 
+
+class SingletonFutexUnitTest : public Singleton<SingletonFutexUnitTest, util::lock::FutexLock>
+{
+public:
+    int i;
+};
+
+CASE_TEST(SingletonTest, LockType)
+{
+    SingletonFutexUnitTest* pl = SingletonFutexUnitTest::Instance();
+    pl->i = 2048;
+
+    CASE_EXPECT_EQ(pl, &SingletonFutexUnitTest::GetInstance());
+    CASE_EXPECT_EQ(2048, SingletonFutexUnitTest::GetConstInstance().i);
+}
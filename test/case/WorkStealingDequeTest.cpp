@@ -0,0 +1,95 @@
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "frame/test_macros.h"
+
+#include "DataStructure/work_stealing_deque.h"
+
+
+CASE_TEST(WorkStealingDequeTest, basic)
+{
+    util::ds::work_stealing_deque<int> deque(2);
+    int v = 0;
+    CASE_EXPECT_FALSE(deque.pop(v));
+    CASE_EXPECT_FALSE(deque.steal(v));
+
+    // 超过初始容量时扩容
+    for (int i = 0; i < 10; ++i) {
+        deque.push(i);
+    }
+    CASE_EXPECT_EQ(10, deque.size());
+    CASE_EXPECT_EQ(16, deque.capacity());
+
+    // 所有者后进先出，窃取者先进先出
+    CASE_EXPECT_TRUE(deque.pop(v));
+    CASE_EXPECT_EQ(9, v);
+    CASE_EXPECT_TRUE(deque.steal(v));
+    CASE_EXPECT_EQ(0, v);
+    CASE_EXPECT_TRUE(deque.steal(v));
+    CASE_EXPECT_EQ(1, v);
+
+    for (int i = 8; i >= 2; --i) {
+        CASE_EXPECT_TRUE(deque.pop(v));
+        CASE_EXPECT_EQ(i, v);
+    }
+    CASE_EXPECT_FALSE(deque.pop(v));
+    CASE_EXPECT_FALSE(deque.steal(v));
+    CASE_EXPECT_TRUE(deque.empty());
+}
+
+CASE_TEST(WorkStealingDequeTest, concurrent_steal)
+{
+    const int task_num = 100000;
+    const int thief_num = 4;
+    util::ds::work_stealing_deque<int> deque(16);
+    std::vector<std::atomic<int> > taken(task_num);
+    for (int i = 0; i < task_num; ++i) {
+        taken[i].store(0);
+    }
+
+    std::atomic<int> done_count;
+    done_count.store(0);
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < thief_num; ++i) {
+        thieves.push_back(std::thread([&deque, &taken, &done_count, task_num]() {
+            int v;
+            while (done_count.load(std::memory_order_acquire) < task_num) {
+                if (deque.steal(v)) {
+                    taken[v].fetch_add(1);
+                    done_count.fetch_add(1, std::memory_order_release);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    // 所有者交替放入和取出，和窃取者竞争最后一个元素
+    int v;
+    for (int i = 0; i < task_num; ++i) {
+        deque.push(i);
+        if (0 == i % 3 && deque.pop(v)) {
+            taken[v].fetch_add(1);
+            done_count.fetch_add(1, std::memory_order_release);
+        }
+    }
+    while (deque.pop(v)) {
+        taken[v].fetch_add(1);
+        done_count.fetch_add(1, std::memory_order_release);
+    }
+
+    for (size_t i = 0; i < thieves.size(); ++i) {
+        thieves[i].join();
+    }
+
+    int bad = 0;
+    for (int i = 0; i < task_num; ++i) {
+        if (1 != taken[i].load()) {
+            ++bad;
+        }
+    }
+    CASE_EXPECT_EQ(0, bad);
+    CASE_EXPECT_EQ(task_num, done_count.load());
+}